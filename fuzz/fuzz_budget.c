@@ -0,0 +1,85 @@
+#include "fuzz_budget.h"
+#include "alloc.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define FUZZ_TIME_RETRIES 3
+
+typedef struct {
+	uint64_t base_ns;
+	uint64_t ns_per_byte;
+	size_t base_bytes;
+	size_t bytes_per_byte;
+	size_t allocs_per_byte;
+} MCFuzzLimits_t;
+
+static uint64_t env_limit(const char *name, uint64_t fallback) {
+	const char *value = getenv(name);
+	return value ? strtoull(value, NULL, 10) : fallback;
+}
+
+static const MCFuzzLimits_t *limits(void) {
+	static MCFuzzLimits_t l;
+	static int loaded = 0;
+	if (!loaded) {
+		l.base_ns = env_limit("MARKCORE_FUZZ_BASE_NS", 10 * 1000 * 1000);
+		l.ns_per_byte = env_limit("MARKCORE_FUZZ_NS_PER_BYTE", 2000);
+		// the worst case parse peak markcore.h documents, rendering has to stay under it too
+		l.base_bytes = env_limit("MARKCORE_FUZZ_BASE_BYTES", MARKCORE_PEAK_BASE_BYTES);
+		l.bytes_per_byte = env_limit("MARKCORE_FUZZ_BYTES_PER_BYTE", MARKCORE_PEAK_WORST_BYTES_PER_INPUT_BYTE);
+		l.allocs_per_byte = env_limit("MARKCORE_FUZZ_ALLOCS_PER_BYTE", 8);
+		loaded = 1;
+	}
+	return &l;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t timed_run(MCFuzzRun_f run, const char *markdown, size_t size) {
+	uint64_t start = now_ns();
+	run(markdown, size);
+	return now_ns() - start;
+}
+
+void fuzz_run_with_budget(const char *target, MCFuzzRun_f run, const uint8_t *data, size_t size) {
+	const MCFuzzLimits_t *l = limits();
+	const char *markdown = (const char *)data;
+	
+	mc_alloc_stats_reset();
+	uint64_t elapsed = timed_run(run, markdown, size);
+	
+	MCAllocStats_t stats;
+	mc_alloc_stats(&stats);
+	
+	// timing is noisy, only trust the best of a few runs
+	uint64_t time_budget = l->base_ns + l->ns_per_byte * size;
+	for (int i = 1; i < FUZZ_TIME_RETRIES && elapsed > time_budget; i++) {
+		uint64_t retry = timed_run(run, markdown, size);
+		if (retry < elapsed) elapsed = retry;
+	}
+	
+	size_t peak_budget = l->base_bytes + l->bytes_per_byte * size;
+	size_t alloc_budget = 64 + l->allocs_per_byte * size;
+	
+	int over = 0;
+	if (elapsed > time_budget) {
+		fprintf(stderr, "[%s] %zu byte input took %llu ns (budget %llu ns)\n", target, size,
+			(unsigned long long)elapsed, (unsigned long long)time_budget);
+		over = 1;
+	}
+	if (stats.peak_bytes > peak_budget) {
+		fprintf(stderr, "[%s] %zu byte input peaked at %zu heap bytes (budget %zu)\n", target, size, stats.peak_bytes, peak_budget);
+		over = 1;
+	}
+	if (stats.allocations > alloc_budget) {
+		fprintf(stderr, "[%s] %zu byte input made %zu allocations (budget %zu)\n", target, size, stats.allocations, alloc_budget);
+		over = 1;
+	}
+	
+	if (over) abort();
+}
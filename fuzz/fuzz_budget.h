@@ -0,0 +1,22 @@
+#ifndef MARKCORE_FUZZ_BUDGET_H
+#define MARKCORE_FUZZ_BUDGET_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+Per input cost budgets for the fuzz targets. Both budgets are linear in the input size,
+so an input that trips them is one whose cost grows faster than its length. Overshoots
+abort() so libFuzzer / AFL keep the input as a crash, save it to fuzz/regressions.
+
+Limits can be overridden from the environment (sanitizer builds are slower):
+	MARKCORE_FUZZ_BASE_NS, MARKCORE_FUZZ_NS_PER_BYTE
+	MARKCORE_FUZZ_BASE_BYTES, MARKCORE_FUZZ_BYTES_PER_BYTE (peak live heap)
+	MARKCORE_FUZZ_ALLOCS_PER_BYTE
+*/
+
+typedef void (*MCFuzzRun_f)(const char *markdown, size_t size);
+
+void fuzz_run_with_budget(const char *target, MCFuzzRun_f run, const uint8_t *data, size_t size);
+
+#endif
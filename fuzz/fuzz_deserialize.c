@@ -0,0 +1,26 @@
+#include "fuzz_budget.h"
+#include "markcore.h"
+
+#include <stdio.h>
+
+static FILE *sink;
+
+// inputs are serialized blobs, both the in place and the rebuilt tree renders have to survive them
+static void run_deserialize(const char *blob, size_t size) {
+	(void)markcore_render_serialized_to_file(blob, size, sink);
+	
+	MCDocument_t *doc = markcore_document_deserialize(blob, size);
+	if (!doc) return;
+	for (int format = MARKCORE_FORMAT_HTML; format <= MARKCORE_FORMAT_ANSI; format++) {
+		(void)markcore_document_render_format_to_file(doc, format, sink);
+	}
+	markcore_document_free(doc);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (!sink) sink = fopen("/dev/null", "w");
+	if (!sink) return 0;
+	
+	fuzz_run_with_budget("deserialize", run_deserialize, data, size);
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+Driver for compilers without libFuzzer. Runs every file given on the command line
+(or stdin) through the target once, which is also how AFL calls it: afl-fuzz ... -- ./markcore-fuzz-parse @@
+*/
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static int run_stream(FILE *fp) {
+	size_t size = 0;
+	size_t capacity = 4096;
+	uint8_t *data = malloc(capacity);
+	if (!data) return 1;
+	
+	size_t n;
+	while ((n = fread(data + size, 1, capacity - size, fp)) > 0) {
+		size += n;
+		if (size == capacity) {
+			capacity *= 2;
+			uint8_t *grown = realloc(data, capacity);
+			if (!grown) {
+				free(data);
+				return 1;
+			}
+			data = grown;
+		}
+	}
+	
+	LLVMFuzzerTestOneInput(data, size);
+	free(data);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) return run_stream(stdin);
+	
+	for (int i = 1; i < argc; i++) {
+		FILE *fp = fopen(argv[i], "rb");
+		if (!fp) {
+			fprintf(stderr, "Couldn't open file: %s\n", argv[i]);
+			return 1;
+		}
+		int result = run_stream(fp);
+		fclose(fp);
+		if (result) return result;
+	}
+	return 0;
+}
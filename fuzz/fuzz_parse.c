@@ -0,0 +1,12 @@
+#include "fuzz_budget.h"
+#include "parser.h"
+
+static void run_parse(const char *markdown, size_t size) {
+	MCNode_t *root = markcore_parse(markdown, size);
+	markcore_free_syntax_tree(root);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	fuzz_run_with_budget("parse", run_parse, data, size);
+	return 0;
+}
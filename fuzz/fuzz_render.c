@@ -0,0 +1,18 @@
+#include "fuzz_budget.h"
+#include "markcore.h"
+
+#include <stdio.h>
+
+static FILE *sink;
+
+static void run_render(const char *markdown, size_t size) {
+	(void)markcore_render_to_file(markdown, size, sink);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (!sink) sink = fopen("/dev/null", "w");
+	if (!sink) return 0;
+	
+	fuzz_run_with_budget("render", run_render, data, size);
+	return 0;
+}
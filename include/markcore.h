@@ -5,6 +5,19 @@
 
 #include <stdio.h>
 
+// Symbols exported from the shared library, everything else is hidden
+#if defined(_WIN32) && defined(MARKCORE_SHARED)
+	#ifdef MARKCORE_BUILDING
+		#define MARKCORE_API __declspec(dllexport)
+	#else
+		#define MARKCORE_API __declspec(dllimport)
+	#endif
+#elif defined(__GNUC__)
+	#define MARKCORE_API __attribute__((visibility("default")))
+#else
+	#define MARKCORE_API
+#endif
+
 // typedef enum {
 // 	enable_code_blocks = 1 << 0,
 // } MarkCoreOptions_e;
@@ -19,8 +32,446 @@ Returns dynamically allocated array with contents. Please free()
 // 								 char *write_buffer,
 // 								 size_t buffer_size);
 
-size_t markcore_render_to_file(const char *markdown,
-							   size_t length,
-							   FILE *out_file);
+MARKCORE_API size_t markcore_render_to_file(const char *markdown,
+											size_t length,
+											FILE *out_file);
+
+// Parsed documents =========================================
+
+typedef struct MCDocument MCDocument_t;
+typedef struct MCInternTable MCInternTable_t;
+typedef struct MCHighlightCache MCHighlightCache_t;
+
+// Return a malloc()ed replacement for url, or NULL to keep it
+typedef char *(*MarkCoreUrlRewrite_f)(const char *url, void *userdata);
+
+// Every distinct url of the document in one call, set rewritten[i] (malloc()ed) or leave it NULL
+typedef void (*MarkCoreUrlRewriteBatch_f)(const char **urls,
+										  char **rewritten,
+										  size_t count,
+										  void *userdata);
+
+// HTML for a fenced code block, malloc()ed, or NULL to write the code escaped as usual.
+// lang is the first word of the info string, "" without one
+typedef char *(*MarkCoreHighlight_f)(const char *code,
+									 size_t length,
+									 const char *lang,
+									 size_t *out_length,
+									 void *userdata);
+
+// Profiling, source line (1 based) an inline parsed paragraph or table cell starts on and
+// the nanoseconds its inline parse took
+typedef void (*MarkCoreInlineProfile_f)(size_t line, unsigned long long ns, void *userdata);
+
+typedef enum {
+	MARKCORE_OK = 0,
+	MARKCORE_LIMIT_INPUT_SIZE, // parsed up to the last full line under the limit
+	MARKCORE_LIMIT_NODES, // parsing stopped at the node limit
+	MARKCORE_LIMIT_DEPTH, // emphasis past the depth limit was kept as text
+	MARKCORE_LIMIT_TIME, // parsing stopped once the time budget ran out
+	MARKCORE_LIMIT_OUTPUT, // rendering skipped the nodes past the output limit
+} MarkCoreStatus_e;
+
+/*
+Hard per document limits, 0 means unlimited. A tripped limit still leaves a complete,
+renderable document (whatever was parsed or rendered before the limit), with the
+reason reported by markcore_document_status().
+*/
+typedef struct {
+	size_t max_input_bytes;
+	size_t max_nodes;
+	int max_depth;
+	size_t max_output_bytes; // per render, closing tags of open elements are still written
+	unsigned long max_parse_us; // checked every 64 lines
+} MarkCoreLimits_t;
+
+typedef struct {
+	// Link and image url rewriting, each distinct url is rewritten once per document.
+	// The batch callback takes precedence when both are set.
+	MarkCoreUrlRewrite_f url_rewrite;
+	MarkCoreUrlRewriteBatch_f url_rewrite_batch;
+	void *url_rewrite_userdata;
+	
+	// Collect the heading index while parsing, give headings id anchors, enables the TOC
+	int heading_ids;
+	
+	MarkCoreLimits_t limits;
+	
+	// Store each distinct node string once, per document or in a table shared across
+	// documents (must outlive them, one parse at a time)
+	int intern_strings;
+	MCInternTable_t *shared_strings;
+	
+	// Keep compressed HTML with the document once it has been rendered, see markcore_document_compressed
+	int cache_compressed;
+	
+	// Record the source byte range of every node (same node size, a line start index per
+	// document), token offsets become per word. sourcepos_attributes also writes
+	// data-sourcepos="line:col-line:col" (1 based, inclusive) on HTML block tags
+	int source_positions;
+	int sourcepos_attributes;
+	
+	// Server side highlighting of code blocks in HTML output. With a cache (shared across
+	// documents, must outlive them, one render at a time) each distinct snippet is highlighted once.
+	// Snapshots don't use the cache
+	MarkCoreHighlight_f highlight;
+	void *highlight_userdata;
+	MCHighlightCache_t *highlight_cache;
+	
+	// Called after each inline parse, for finding which lines are slow. Off when NULL
+	MarkCoreInlineProfile_f inline_profile;
+	void *inline_profile_userdata;
+	
+	// Run markcore_document_shrink once parsing is done
+	int shrink_to_fit;
+} MarkCoreOptions_t;
+
+typedef enum {
+	MARKCORE_GZIP,
+	MARKCORE_DEFLATE, // zlib wrapped, what HTTP calls "deflate"
+} MarkCoreCompression_e;
+
+// Parse once, render as many times as needed
+MARKCORE_API MCDocument_t *markcore_document_parse(const char *markdown, size_t length);
+MARKCORE_API MCDocument_t *markcore_document_parse_with_options(const char *markdown,
+																size_t length,
+																const MarkCoreOptions_t *options);
+MARKCORE_API size_t markcore_document_render_to_file(MCDocument_t *doc, FILE *out_file);
+
+typedef enum {
+	MARKCORE_FORMAT_HTML,
+	MARKCORE_FORMAT_TEXT, // plain text, for search indexing
+	MARKCORE_FORMAT_JSON, // syntax tree as nested objects
+	MARKCORE_FORMAT_ANSI, // styled terminal output
+} MarkCoreFormat_e;
+
+MARKCORE_API size_t markcore_document_render_format_to_file(MCDocument_t *doc, MarkCoreFormat_e format, FILE *out_file);
+
+/*
+Custom HTML without writing a renderer. A template holds open and close markup for element
+kinds, compiled once into literal bytes and placeholder slots, and elements left unset keep
+the built-in markup. Placeholders, anything else is rejected ("{{" writes a brace):
+	{sourcepos}  data-sourcepos attribute with its leading space, empty unless sourcepos_attributes
+	{level}      heading level
+	{id}         heading anchor (needs heading_ids, empty otherwise)
+	{lang}       code block language, empty without an info string
+	{text}       heading text, image alt
+	{url}        link and image url
+	{align}      table cell align attribute with its leading space, empty when unaligned
+Headings, links and inline code write their text between open and close, images only use open.
+*/
+typedef struct MCHtmlTemplate MCHtmlTemplate_t;
+
+typedef enum {
+	MARKCORE_TEMPLATE_PARAGRAPH,
+	MARKCORE_TEMPLATE_HEADER,
+	MARKCORE_TEMPLATE_CODE_BLOCK,
+	MARKCORE_TEMPLATE_CODE_INLINE,
+	MARKCORE_TEMPLATE_BOLD,
+	MARKCORE_TEMPLATE_ITALIC,
+	MARKCORE_TEMPLATE_LINK,
+	MARKCORE_TEMPLATE_IMAGE,
+	MARKCORE_TEMPLATE_UNORDERED_LIST,
+	MARKCORE_TEMPLATE_ORDERED_LIST,
+	MARKCORE_TEMPLATE_LIST_ITEM,
+	MARKCORE_TEMPLATE_BLOCKQUOTE,
+	MARKCORE_TEMPLATE_TABLE, // rows and <thead>/<tbody> stay built in
+	MARKCORE_TEMPLATE_TABLE_HEADER_CELL,
+	MARKCORE_TEMPLATE_TABLE_CELL,
+	MARKCORE_TEMPLATE_COUNT
+} MarkCoreTemplateElement_e;
+
+MARKCORE_API MCHtmlTemplate_t *markcore_html_template_create(void);
+
+// Returns 0 on an unknown placeholder (the element keeps its previous markup). NULL is empty markup
+MARKCORE_API int markcore_html_template_set(MCHtmlTemplate_t *tmpl,
+											MarkCoreTemplateElement_e element,
+											const char *open,
+											const char *close);
+MARKCORE_API void markcore_html_template_free(MCHtmlTemplate_t *tmpl);
+
+// The template can be shared by any number of renders, including concurrent ones
+MARKCORE_API size_t markcore_document_render_template_to_file(MCDocument_t *doc,
+															  const MCHtmlTemplate_t *tmpl,
+															  FILE *out_file);
+
+// Headings (needs heading_ids), in document order. Text is not NUL terminated
+MARKCORE_API size_t markcore_document_heading_count(MCDocument_t *doc);
+MARKCORE_API int markcore_document_heading(MCDocument_t *doc,
+										   size_t index,
+										   int *level,
+										   const char **text,
+										   size_t *text_len,
+										   const char **anchor);
+
+// Table of contents as nested lists linking to the heading anchors
+MARKCORE_API size_t markcore_document_render_toc_to_file(MCDocument_t *doc, FILE *out_file);
+
+/*
+Partial rendering for paged views. Blocks are the top level elements (paragraph line,
+header, list, blockquote, table, code block, image) in document order.
+*/
+MARKCORE_API size_t markcore_document_block_count(MCDocument_t *doc);
+
+// Block containing a source byte offset, O(log n). Block count if unknown (deserialized documents)
+MARKCORE_API size_t markcore_document_block_at_offset(MCDocument_t *doc, size_t offset);
+
+// 1 based line and byte column of a source offset (needs source_positions). Returns 0 if unknown
+MARKCORE_API int markcore_document_line_column(MCDocument_t *doc, size_t offset, size_t *line, size_t *column);
+
+// Blocks [first_block, last_block)
+MARKCORE_API size_t markcore_document_render_blocks_to_file(MCDocument_t *doc,
+															size_t first_block,
+															size_t last_block,
+															FILE *out_file);
+
+// A heading and everything up to the next heading of the same or higher level (needs heading_ids)
+MARKCORE_API size_t markcore_document_render_section_to_file(MCDocument_t *doc, size_t heading, FILE *out_file);
+
+// From first_heading up to, not including, last_heading (or the end when past the last heading)
+MARKCORE_API size_t markcore_document_render_headings_to_file(MCDocument_t *doc,
+															  size_t first_heading,
+															  size_t last_heading,
+															  FILE *out_file);
+
+/*
+Search index extraction, no rendering. Every word of the document is reported with what
+it is part of and a weight. Words are runs of ASCII letters and digits plus any byte >= 0x80,
+so UTF-8 words stay whole. They point into the document as written (not NUL terminated),
+valid until the document is freed.
+*/
+typedef enum {
+	MARKCORE_TOKEN_TEXT,
+	MARKCORE_TOKEN_HEADING,
+	MARKCORE_TOKEN_EMPHASIS,
+	MARKCORE_TOKEN_LINK, // link text
+	MARKCORE_TOKEN_IMAGE_ALT,
+	MARKCORE_TOKEN_CODE,
+} MarkCoreTokenKind_e;
+
+#define MARKCORE_NO_OFFSET ((size_t)-1)
+
+typedef struct {
+	const char *text;
+	size_t len;
+	MarkCoreTokenKind_e kind;
+	int heading_level; // heading tokens only
+	int weight; // 1 for body text, more for headings (h1 highest), emphasis and link text
+	size_t block; // top level block the word is in
+	size_t offset; // source byte offset of the word with source_positions, of its block otherwise,
+				   // MARKCORE_NO_OFFSET for deserialized documents
+} MarkCoreToken_t;
+
+typedef void (*MarkCoreToken_f)(const MarkCoreToken_t *token, void *userdata);
+
+// Returns the number of tokens reported
+MARKCORE_API size_t markcore_document_extract_tokens(MCDocument_t *doc, MarkCoreToken_f callback, void *userdata);
+
+/*
+Plugin passes (spellcheck, link checks, ...) run inside the render walk, so any number of
+passes plus the render is still one traversal. A pass visits the node types set in its
+node_mask: pre is called before a node renders, post after its children. Hooks only read
+nodes. Trees are shared with snapshots and renderers use interned and pre-escaped copies
+of node strings, so an edit would leak into other documents or not show up at all.
+*/
+typedef struct MCNode MCNode_t;
+typedef struct MCPassPipeline MCPassPipeline_t;
+
+// Same order as markcore_node_type_name
+typedef enum {
+	MARKCORE_NODE_ROOT,
+	MARKCORE_NODE_LINE,
+	MARKCORE_NODE_TEXT,
+	MARKCORE_NODE_LINK,
+	MARKCORE_NODE_HEADER,
+	MARKCORE_NODE_IMAGE,
+	MARKCORE_NODE_BOLD,
+	MARKCORE_NODE_ITALIC,
+	MARKCORE_NODE_CODE_INLINE,
+	MARKCORE_NODE_UNORDERED_LIST,
+	MARKCORE_NODE_ORDERED_LIST,
+	MARKCORE_NODE_CODE_BLOCK,
+	MARKCORE_NODE_BOLD_ITALIC,
+	MARKCORE_NODE_LIST_ITEM,
+	MARKCORE_NODE_BLOCKQUOTE,
+	MARKCORE_NODE_TABLE,
+	MARKCORE_NODE_TABLE_ROW,
+	MARKCORE_NODE_TABLE_CELL,
+	MARKCORE_NODE_TYPE_COUNT
+} MarkCoreNodeType_e;
+
+#define MARKCORE_NODE_MASK(type) (1u << (type))
+#define MARKCORE_NODE_MASK_ALL ((1u << MARKCORE_NODE_TYPE_COUNT) - 1)
+
+typedef void (*MarkCorePassHook_f)(const MCNode_t *node, void *userdata);
+
+#define MARKCORE_PASS_VERSION 1
+
+typedef struct {
+	int version; // MARKCORE_PASS_VERSION, newer versions only add fields at the end
+	const char *name;
+	unsigned int node_mask; // MARKCORE_NODE_MASK bits of the types to visit
+	MarkCorePassHook_f pre; // either may be NULL
+	MarkCorePassHook_f post;
+	void *userdata;
+} MarkCorePass_t;
+
+MARKCORE_API MCPassPipeline_t *markcore_pass_pipeline_create(void);
+MARKCORE_API void markcore_pass_pipeline_free(MCPassPipeline_t *pipeline);
+
+// Pass is copied. 0 when the pipeline is full or the pass version is unknown
+MARKCORE_API int markcore_pass_pipeline_register(MCPassPipeline_t *pipeline, const MarkCorePass_t *pass);
+
+// Walk the passes over the document without rendering
+MARKCORE_API void markcore_pass_pipeline_run(MCPassPipeline_t *pipeline, MCDocument_t *doc);
+
+// Render with the passes fused into the same traversal
+MARKCORE_API size_t markcore_document_render_with_passes(MCDocument_t *doc,
+														 MCPassPipeline_t *passes,
+														 FILE *out_file);
+
+// Node fields for pass hooks. Content is the text of text and code nodes, data the url of
+// links and images, the anchor of headers and the language of code blocks. NULL when unset
+MARKCORE_API MarkCoreNodeType_e markcore_node_type(const MCNode_t *node);
+MARKCORE_API const char *markcore_node_content(const MCNode_t *node);
+MARKCORE_API const char *markcore_node_data(const MCNode_t *node);
+MARKCORE_API void markcore_document_free(MCDocument_t *doc);
+
+// String tables for MarkCoreOptions_t.shared_strings
+MARKCORE_API MCInternTable_t *markcore_strings_create(void);
+MARKCORE_API void markcore_strings_free(MCInternTable_t *strings);
+
+// Highlight caches for MarkCoreOptions_t.highlight_cache. Past max_bytes (0 for no bound) the
+// cache starts over empty
+MARKCORE_API MCHighlightCache_t *markcore_highlight_cache_create(size_t max_bytes);
+MARKCORE_API void markcore_highlight_cache_stats(MCHighlightCache_t *cache,
+												 size_t *hits,
+												 size_t *misses,
+												 size_t *bytes);
+MARKCORE_API void markcore_highlight_cache_free(MCHighlightCache_t *cache);
+
+/*
+Compressed HTML. Bytes go through the encoder as the renderer produces them, there is no
+uncompressed copy of the document. Needs a build with zlib (MARKCORE_COMPRESSION), returns
+0 / NULL without it. Level is a zlib level, -1 for the default.
+*/
+MARKCORE_API size_t markcore_document_render_compressed_to_file(MCDocument_t *doc,
+																MarkCoreCompression_e format,
+																int level,
+																FILE *out_file);
+
+// Compressed HTML owned by the document (needs cache_compressed), rendered on first use and
+// kept until the document is freed or a different format/level is asked for
+MARKCORE_API const void *markcore_document_compressed(MCDocument_t *doc,
+													  MarkCoreCompression_e format,
+													  int level,
+													  size_t *size);
+
+/*
+Profiling. Nodes of the tree by type: counts needs markcore_node_type_count() entries, type i
+is named markcore_node_type_name(i). Returns the total. Nodes shared between snapshots are
+counted once per tree they are reachable from.
+*/
+MARKCORE_API size_t markcore_node_type_count(void);
+MARKCORE_API const char *markcore_node_type_name(size_t type);
+MARKCORE_API size_t markcore_document_count_nodes(MCDocument_t *doc, size_t *counts);
+
+// Library allocations made on the calling thread. Counted only in MARKCORE_INSTRUMENT builds,
+// markcore_alloc_stats returns 0 and zeroes stats otherwise
+typedef struct {
+	size_t allocations;
+	size_t bytes_allocated;
+	size_t live_bytes;
+	size_t peak_bytes;
+} MarkCoreAllocStats_t;
+
+MARKCORE_API int markcore_alloc_stats(MarkCoreAllocStats_t *stats);
+MARKCORE_API void markcore_alloc_stats_reset(void); // counts and peak start over from the live bytes
+
+/*
+Memory footprint. Exact bytes the library has allocated for a document (what it asked the
+allocator for, not allocator overhead).
+
+Peak library heap while parsing, with every option on. Documents stay under
+MARKCORE_PEAK_BASE_BYTES + MARKCORE_PEAK_BYTES_PER_INPUT_BYTE * length: test.md peaks at
+3.6 bytes per input byte, the base covers the fixed tables of tiny inputs (26 KiB).
+Markup built to make a node every couple of bytes (fuzz/regressions/peak-*) reaches 73
+bytes per input byte, the worst case bound. ctest checks both, the fuzz budget the worst.
+*/
+#define MARKCORE_PEAK_BASE_BYTES (32 * 1024)
+#define MARKCORE_PEAK_BYTES_PER_INPUT_BYTE 4
+#define MARKCORE_PEAK_WORST_BYTES_PER_INPUT_BYTE 80
+
+typedef struct {
+	size_t nodes; // node structs
+	size_t children; // child pointer arrays, unused capacity included
+	size_t strings; // node strings the tree owns
+	size_t string_table; // interned strings, when the document owns its table
+	size_t indexes; // block, line and heading indexes, url table
+	size_t cache; // compressed HTML kept with cache_compressed
+	size_t total; // all of the above and the document itself
+} MarkCoreMemory_t;
+
+// Returns the total, memory may be NULL. Trees shared with snapshots count in full for each
+MARKCORE_API size_t markcore_document_memory(MCDocument_t *doc, MarkCoreMemory_t *memory);
+
+// Trims child arrays and the block/line indexes to what they hold, for documents kept around
+// after parsing. Nodes shared with snapshots are left alone. Returns bytes released
+MARKCORE_API size_t markcore_document_shrink(MCDocument_t *doc);
+
+// MARKCORE_OK, or the first limit that tripped while parsing or rendering the document
+MARKCORE_API MarkCoreStatus_e markcore_document_status(MCDocument_t *doc);
+
+/*
+Pull based rendering for event loops. Each read fills the caller's buffer with the next
+chunk of HTML and returns, so the render suspends whenever the buffer is full and resumes
+on the next read. Only the output of the node being rendered is buffered, never the whole
+document. The document must outlive the stream.
+*/
+typedef struct MCRenderStream MCRenderStream_t;
+
+MARKCORE_API MCRenderStream_t *markcore_render_stream_create(MCDocument_t *doc);
+
+// Bytes copied into buffer, less than size only once the document is finished
+MARKCORE_API size_t markcore_render_stream_read(MCRenderStream_t *stream, char *buffer, size_t size);
+MARKCORE_API int markcore_render_stream_done(MCRenderStream_t *stream);
+
+// Same, compressed while rendering (level is a zlib level, -1 for the default)
+MARKCORE_API MCRenderStream_t *markcore_render_stream_create_compressed(MCDocument_t *doc,
+																		MarkCoreCompression_e format,
+																		int level);
+MARKCORE_API void markcore_render_stream_free(MCRenderStream_t *stream);
+
+/*
+Snapshots for concurrent readers. A snapshot is a read only document sharing the tree of
+doc (nodes are reference counted), unaffected by later edits to doc or by freeing it. Take
+snapshots on the thread that edits the document and render each one on its own thread,
+no locks needed. Snapshots have no heading or block offset index, no string cache and no
+highlight cache: code blocks still go through the highlight callback, which then has to be
+safe to call from several threads. Free with markcore_document_free.
+*/
+MARKCORE_API MCDocument_t *markcore_document_snapshot(MCDocument_t *doc);
+
+// Replace blocks [first_block, last_block) with the blocks parsed from markdown (an insert when
+// the range is empty). Copy on write: the new tree shares every other block with the old one.
+// Block offsets are dropped and headings reindexed, new headings get anchors no kept heading
+// uses. 0 on failure (doc unchanged) or for snapshots
+MARKCORE_API int markcore_document_replace_blocks(MCDocument_t *doc,
+												  size_t first_block,
+												  size_t last_block,
+												  const char *markdown,
+												  size_t length);
+
+/*
+Compact binary form of a parsed document. Returns dynamically allocated blob, please free().
+The blob only contains offsets, so it can be stored next to the source, mmapped later
+and rendered in place without parsing or rebuilding the tree.
+*/
+MARKCORE_API void *markcore_document_serialize(MCDocument_t *doc, size_t *out_size);
+MARKCORE_API MCDocument_t *markcore_document_deserialize(const void *blob, size_t size);
+
+MARKCORE_API size_t markcore_render_serialized_to_file(const void *blob,
+													   size_t size,
+													   FILE *out_file);
 
 #endif
\ No newline at end of file
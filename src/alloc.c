@@ -0,0 +1,85 @@
+#include "alloc.h"
+
+#ifdef MARKCORE_INSTRUMENT
+
+#include <stddef.h>
+
+// keeps the returned pointer max_align_t aligned
+typedef union {
+	size_t size;
+	max_align_t align;
+} MCAllocHeader_t;
+
+static _Thread_local MCAllocStats_t stats;
+
+static void track_alloc(size_t size) {
+	stats.allocations++;
+	stats.bytes_allocated += size;
+	stats.live_bytes += size;
+	if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+}
+
+void *mc_malloc(size_t size) {
+	MCAllocHeader_t *header = malloc(sizeof(MCAllocHeader_t) + size);
+	if (!header) return NULL;
+	header->size = size;
+	track_alloc(size);
+	return header + 1;
+}
+
+void *mc_calloc(size_t count, size_t size) {
+	if (size && count > ((size_t)-1 - sizeof(MCAllocHeader_t)) / size) return NULL;
+	void *ptr = mc_malloc(count * size);
+	if (ptr) memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void *mc_realloc(void *ptr, size_t size) {
+	if (!ptr) return mc_malloc(size);
+	
+	MCAllocHeader_t *header = (MCAllocHeader_t *)ptr - 1;
+	size_t old_size = header->size;
+	
+	header = realloc(header, sizeof(MCAllocHeader_t) + size);
+	if (!header) return NULL;
+	header->size = size;
+	
+	stats.live_bytes -= old_size;
+	track_alloc(size);
+	return header + 1;
+}
+
+void mc_free(void *ptr) {
+	if (!ptr) return;
+	MCAllocHeader_t *header = (MCAllocHeader_t *)ptr - 1;
+	stats.live_bytes -= header->size;
+	free(header);
+}
+
+char *mc_strdup(const char *s) {
+	size_t len = strlen(s) + 1;
+	char *copy = mc_malloc(len);
+	if (copy) memcpy(copy, s, len);
+	return copy;
+}
+
+void mc_alloc_stats(MCAllocStats_t *out) {
+	if (out) *out = stats;
+}
+
+void mc_alloc_stats_reset(void) {
+	stats.allocations = 0;
+	stats.bytes_allocated = 0;
+	stats.peak_bytes = stats.live_bytes;
+}
+
+#else
+
+void mc_alloc_stats(MCAllocStats_t *out) {
+	if (out) memset(out, 0, sizeof(MCAllocStats_t));
+}
+
+void mc_alloc_stats_reset(void) {
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef MARKCORE_ALLOC_H
+#define MARKCORE_ALLOC_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "markcore.h"
+
+/*
+Library internal allocations go through mc_* so they can be counted.
+
+Without MARKCORE_INSTRUMENT these are plain libc calls. With it, every block carries a
+small size header and per thread counters (allocations, bytes, live, peak) are kept
+for the fuzz budgets and the cli profiler. Memory handed to or received from callers
+(serialized blobs, rewritten urls) must keep using malloc()/free() directly.
+*/
+
+typedef MarkCoreAllocStats_t MCAllocStats_t; // public as markcore_alloc_stats
+
+#ifdef MARKCORE_INSTRUMENT
+
+void *mc_malloc(size_t size);
+void *mc_calloc(size_t count, size_t size);
+void *mc_realloc(void *ptr, size_t size);
+void mc_free(void *ptr);
+char *mc_strdup(const char *s);
+
+#else
+
+#define mc_malloc(size) malloc(size)
+#define mc_calloc(count, size) calloc((count), (size))
+#define mc_realloc(ptr, size) realloc((ptr), (size))
+#define mc_free(ptr) free(ptr)
+#define mc_strdup(s) strdup(s)
+
+#endif
+
+// zeroed when not instrumented
+void mc_alloc_stats(MCAllocStats_t *out);
+void mc_alloc_stats_reset(void);
+
+#endif
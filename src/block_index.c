@@ -0,0 +1,75 @@
+#include "block_index.h"
+#include "alloc.h"
+
+MCBlockIndex_t *block_index_create(void) {
+	return mc_calloc(1, sizeof(MCBlockIndex_t));
+}
+
+void block_index_destroy(MCBlockIndex_t *index) {
+	if (!index) return;
+	mc_free(index->offsets);
+	mc_free(index);
+}
+
+int block_index_append(MCBlockIndex_t *index, size_t offset) {
+	if (!index) return 0;
+	
+	if (index->count == index->capacity) {
+		size_t capacity = index->capacity ? index->capacity * 2 : 16;
+		size_t *offsets = mc_realloc(index->offsets, sizeof(size_t) * capacity);
+		if (!offsets) return 0;
+		index->offsets = offsets;
+		index->capacity = capacity;
+	}
+	
+	index->offsets[index->count++] = offset;
+	return 1;
+}
+
+size_t block_index_memory(const MCBlockIndex_t *index) {
+	return index ? sizeof(MCBlockIndex_t) + sizeof(size_t) * index->capacity : 0;
+}
+
+size_t block_index_shrink(MCBlockIndex_t *index) {
+	if (!index || index->count == index->capacity) return 0;
+	
+	size_t released = sizeof(size_t) * (index->capacity - index->count);
+	if (index->count == 0) {
+		mc_free(index->offsets);
+		index->offsets = NULL;
+	} else {
+		size_t *offsets = mc_realloc(index->offsets, sizeof(size_t) * index->count);
+		if (!offsets) return 0;
+		index->offsets = offsets;
+	}
+	index->capacity = index->count;
+	return released;
+}
+
+size_t block_index_find(MCBlockIndex_t *index, size_t offset) {
+	if (!index || index->count == 0) return index ? index->count : 0;
+	
+	// last block starting at or before offset
+	size_t lo = 0;
+	size_t hi = index->count;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->offsets[mid] <= offset) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+void block_index_line_column(MCBlockIndex_t *index, size_t offset, size_t *line, size_t *column) {
+	size_t found = block_index_find(index, offset);
+	if (!index || found == index->count) {
+		*line = 1;
+		*column = offset + 1;
+		return;
+	}
+	*line = found + 1;
+	*column = offset - index->offsets[found] + 1;
+}
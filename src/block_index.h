@@ -0,0 +1,28 @@
+#ifndef MARKCORE_BLOCK_INDEX_H
+#define MARKCORE_BLOCK_INDEX_H
+
+#include <stdlib.h>
+
+// Source byte offset of every top level block (root child), in order, filled while parsing
+typedef struct MCBlockIndex {
+	size_t *offsets;
+	size_t count;
+	size_t capacity;
+} MCBlockIndex_t;
+
+MCBlockIndex_t *block_index_create(void);
+void block_index_destroy(MCBlockIndex_t *index);
+
+int block_index_append(MCBlockIndex_t *index, size_t offset);
+
+// Bytes held, and trimming the offsets to what's used (returns bytes released)
+size_t block_index_memory(const MCBlockIndex_t *index);
+size_t block_index_shrink(MCBlockIndex_t *index);
+
+// Block containing offset (binary search), count if the index is empty
+size_t block_index_find(MCBlockIndex_t *index, size_t offset);
+
+// Same structure over line starts: 1 based line and byte column of offset
+void block_index_line_column(MCBlockIndex_t *index, size_t offset, size_t *line, size_t *column);
+
+#endif
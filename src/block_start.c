@@ -0,0 +1,109 @@
+#include "block_start.h"
+
+#include <stdint.h>
+
+typedef enum {
+	BYTE_TEXT = 0,
+	BYTE_BLANK,
+	BYTE_END,
+	BYTE_DIGIT,
+	BYTE_HASH,
+	BYTE_BANG,
+	BYTE_STAR,
+	BYTE_TICK,
+	BYTE_QUOTE,
+	BYTE_CLASS_COUNT
+} MCByteClass_e;
+
+static const uint8_t byte_classes[256] = {
+	['\0'] = BYTE_END, ['\n'] = BYTE_END,
+	[' '] = BYTE_BLANK, ['\t'] = BYTE_BLANK,
+	['0'] = BYTE_DIGIT, ['1'] = BYTE_DIGIT, ['2'] = BYTE_DIGIT, ['3'] = BYTE_DIGIT, ['4'] = BYTE_DIGIT,
+	['5'] = BYTE_DIGIT, ['6'] = BYTE_DIGIT, ['7'] = BYTE_DIGIT, ['8'] = BYTE_DIGIT, ['9'] = BYTE_DIGIT,
+	['#'] = BYTE_HASH,
+	['!'] = BYTE_BANG,
+	['*'] = BYTE_STAR, ['-'] = BYTE_STAR, ['+'] = BYTE_STAR,
+	['`'] = BYTE_TICK,
+	['>'] = BYTE_QUOTE,
+};
+
+static const uint8_t containers[MC_BLOCK_TYPE_COUNT] = {
+	[MC_BLOCK_BULLET] = 1,
+	[MC_BLOCK_ORDERED] = 1,
+	[MC_BLOCK_QUOTE] = 1,
+};
+
+// Matchers, p is at the first non blank byte. They may move content past a marker
+
+static MCBlockType_e match_text(char *p, char **content) {
+	(void)p; (void)content;
+	return MC_BLOCK_PARAGRAPH;
+}
+
+static MCBlockType_e match_end(char *p, char **content) {
+	(void)p; (void)content;
+	return MC_BLOCK_BLANK;
+}
+
+static MCBlockType_e match_header(char *p, char **content) {
+	(void)p; (void)content;
+	return MC_BLOCK_HEADER;
+}
+
+static MCBlockType_e match_image(char *p, char **content) {
+	(void)content;
+	return p[1] == '[' ? MC_BLOCK_IMAGE : MC_BLOCK_PARAGRAPH;
+}
+
+static MCBlockType_e match_bullet(char *p, char **content) {
+	if (p[1] != ' ') return MC_BLOCK_PARAGRAPH;
+	*content = p + 1;
+	return MC_BLOCK_BULLET;
+}
+
+static MCBlockType_e match_fence(char *p, char **content) {
+	(void)content;
+	return (p[1] == '`' && p[2] == '`') ? MC_BLOCK_FENCE : MC_BLOCK_PARAGRAPH;
+}
+
+// '>' and one optional blank
+static MCBlockType_e match_quote(char *p, char **content) {
+	p++;
+	if (*p == ' ' || *p == '\t') p++;
+	*content = p;
+	return MC_BLOCK_QUOTE;
+}
+
+// up to 9 digits, then '.' or ')', then a space
+static MCBlockType_e match_ordered(char *p, char **content) {
+	char *digits = p;
+	while (byte_classes[(uint8_t)*p] == BYTE_DIGIT) p++;
+	if (p - digits > 9) return MC_BLOCK_PARAGRAPH;
+	if (*p != '.' && *p != ')') return MC_BLOCK_PARAGRAPH;
+	p++;
+	if (*p != ' ') return MC_BLOCK_PARAGRAPH;
+	*content = p;
+	return MC_BLOCK_ORDERED;
+}
+
+static MCBlockType_e (*const matchers[BYTE_CLASS_COUNT])(char *p, char **content) = {
+	[BYTE_TEXT] = match_text,
+	[BYTE_BLANK] = match_text, // never reached, blanks are skipped first
+	[BYTE_END] = match_end,
+	[BYTE_DIGIT] = match_ordered,
+	[BYTE_HASH] = match_header,
+	[BYTE_BANG] = match_image,
+	[BYTE_STAR] = match_bullet,
+	[BYTE_TICK] = match_fence,
+	[BYTE_QUOTE] = match_quote,
+};
+
+void classify_block_start(char *line, MCBlockStart_t *block) {
+	char *p = line;
+	while (byte_classes[(uint8_t)*p] == BYTE_BLANK) p++;
+	
+	block->start = p;
+	block->content = p;
+	block->type = matchers[byte_classes[(uint8_t)*p]](p, &block->content);
+	block->container = containers[block->type];
+}
@@ -0,0 +1,32 @@
+#ifndef MARKCORE_BLOCK_START_H
+#define MARKCORE_BLOCK_START_H
+
+/*
+What a line starts, found in one step from its first non blank byte: a 256 entry class
+table (no ctype, so the locale can't change the result) picks a matcher for that class.
+New block syntax is a new class and matcher, lines starting with other bytes never
+reach it.
+*/
+typedef enum {
+	MC_BLOCK_PARAGRAPH,
+	MC_BLOCK_BLANK,
+	MC_BLOCK_HEADER,
+	MC_BLOCK_IMAGE, // "![", still a paragraph if the image doesn't parse
+	MC_BLOCK_BULLET, // '*', '-' or '+' and a space
+	MC_BLOCK_ORDERED,
+	MC_BLOCK_FENCE,
+	MC_BLOCK_QUOTE,
+	MC_BLOCK_TYPE_COUNT
+} MCBlockType_e;
+
+typedef struct {
+	MCBlockType_e type;
+	char *start; // first non blank byte, where the marker is
+	char *content; // past list markers (the space after them is kept) and quote markers, start otherwise
+	int container; // quote or list item, more block starts can follow on the line
+} MCBlockStart_t;
+
+// line must be NUL terminated
+void classify_block_start(char *line, MCBlockStart_t *block);
+
+#endif
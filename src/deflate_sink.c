@@ -0,0 +1,128 @@
+#include "deflate_sink.h"
+#include "alloc.h"
+
+#include <string.h>
+
+#ifdef MARKCORE_ZLIB
+
+#include <zlib.h>
+
+#define DEFLATE_STAGE_SIZE 8192
+#define DEFLATE_OUT_SIZE 16384
+
+typedef struct {
+	z_stream stream;
+	
+	// renderers write in tiny pieces, deflate sees them in stage sized batches
+	unsigned char stage[DEFLATE_STAGE_SIZE];
+	size_t staged;
+	
+	unsigned char out[DEFLATE_OUT_SIZE];
+} MCDeflateState_t;
+
+static int deflate_run(MCSink_t *sink, const unsigned char *data, size_t len, int flush) {
+	MCDeflateState_t *state = sink->state;
+	z_stream *z = &state->stream;
+	
+	z->next_in = (unsigned char *)data;
+	z->avail_in = (uInt)len;
+	
+	int status;
+	do {
+		z->next_out = state->out;
+		z->avail_out = DEFLATE_OUT_SIZE;
+		
+		status = deflate(z, flush);
+		if (status == Z_STREAM_ERROR) return 0;
+		
+		size_t produced = DEFLATE_OUT_SIZE - z->avail_out;
+		if (produced > 0 && sink_write(sink->next, (const char *)state->out, produced) < produced) return 0;
+	} while (z->avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+	
+	return 1;
+}
+
+static int deflate_flush_stage(MCSink_t *sink) {
+	MCDeflateState_t *state = sink->state;
+	if (state->staged == 0) return 1;
+	
+	int ok = deflate_run(sink, state->stage, state->staged, Z_NO_FLUSH);
+	state->staged = 0;
+	return ok;
+}
+
+static size_t deflate_sink_write(MCSink_t *sink, const char *data, size_t len) {
+	MCDeflateState_t *state = sink->state;
+	if (!state) return 0;
+	
+	if (state->staged + len <= DEFLATE_STAGE_SIZE) {
+		memcpy(state->stage + state->staged, data, len);
+		state->staged += len;
+		return len;
+	}
+	
+	if (!deflate_flush_stage(sink)) return 0;
+	
+	// big writes (code blocks) skip the stage
+	if (len > DEFLATE_STAGE_SIZE) {
+		return deflate_run(sink, (const unsigned char *)data, len, Z_NO_FLUSH) ? len : 0;
+	}
+	
+	memcpy(state->stage, data, len);
+	state->staged = len;
+	return len;
+}
+
+static int deflate_sink_finish(MCSink_t *sink) {
+	MCDeflateState_t *state = sink->state;
+	if (!state) return 0;
+	
+	int ok = deflate_run(sink, state->stage, state->staged, Z_FINISH);
+	state->staged = 0;
+	return ok;
+}
+
+static void deflate_sink_release(MCSink_t *sink) {
+	MCDeflateState_t *state = sink->state;
+	if (!state) return;
+	deflateEnd(&state->stream);
+	mc_free(state);
+}
+
+int sink_init_deflate(MCSink_t *sink, MCSink_t *next, MCDeflateFormat_e format, int level) {
+	memset(sink, 0, sizeof(MCSink_t));
+	if (!next) return 0;
+	
+	MCDeflateState_t *state = mc_malloc(sizeof(MCDeflateState_t));
+	if (!state) return 0;
+	memset(&state->stream, 0, sizeof(z_stream));
+	state->staged = 0;
+	
+	int window_bits = 15;
+	if (format == MC_DEFLATE_RAW) window_bits = -15;
+	if (format == MC_DEFLATE_GZIP) window_bits = 15 + 16;
+	
+	if (deflateInit2(&state->stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		mc_free(state);
+		return 0;
+	}
+	
+	sink->write = deflate_sink_write;
+	sink->finish = deflate_sink_finish;
+	sink->release = deflate_sink_release;
+	sink->next = next;
+	sink->state = state;
+	return 1;
+}
+
+#else
+
+int sink_init_deflate(MCSink_t *sink, MCSink_t *next, MCDeflateFormat_e format, int level) {
+	(void)next;
+	(void)format;
+	(void)level;
+	memset(sink, 0, sizeof(MCSink_t));
+	return 0;
+}
+
+#endif
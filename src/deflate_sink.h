@@ -0,0 +1,23 @@
+#ifndef MARKCORE_DEFLATE_SINK_H
+#define MARKCORE_DEFLATE_SINK_H
+
+#include "sink.h"
+
+/*
+Compressing filter sink. Rendered bytes are staged in a small buffer and deflated
+straight into next as they are produced, so compressed output never needs the full
+HTML in memory first. sink_finish writes the end of the stream.
+
+Needs zlib (MARKCORE_ZLIB), without it sink_init_deflate always fails.
+*/
+
+typedef enum {
+	MC_DEFLATE_RAW, // raw deflate, no header
+	MC_DEFLATE_ZLIB, // zlib wrapper, what HTTP calls "deflate"
+	MC_DEFLATE_GZIP,
+} MCDeflateFormat_e;
+
+// level is a zlib level, -1 for the default. Returns 0 on failure
+int sink_init_deflate(MCSink_t *sink, MCSink_t *next, MCDeflateFormat_e format, int level);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MARKCORE_DOCUMENT_H
+#define MARKCORE_DOCUMENT_H
+
+#include "markcore.h"
+#include "types.h"
+#include "url_table.h"
+#include "headings.h"
+#include "block_index.h"
+#include "intern.h"
+#include "highlight.h"
+
+#include <stdatomic.h>
+
+// Parsed document behind the opaque MCDocument_t handle in markcore.h
+struct MCDocument {
+	MCNode_t *root;
+	
+	// the document and its snapshots, freed with the last
+	atomic_uint refcount;
+	
+	// snapshots: the parsed document whose tables (strings, urls, lines) the nodes borrow
+	// from, kept alive by the snapshot. Snapshots own nothing but their handle on the tree
+	MCDocument_t *origin;
+	
+	MCUrlTable_t *urls; // only when url rewriting was requested
+	MCHeadingIndex_t *headings; // only with heading_ids
+	MCBlockIndex_t *blocks; // not available for deserialized documents
+	MCBlockIndex_t *lines; // line starts, only with source positions
+	int sourcepos_attributes;
+	
+	MCInternTable_t *strings; // nodes borrow interned strings from here
+	int owns_strings;
+	
+	MCHighlighter_t highlighter; // code block highlighting for HTML, when highlight is set
+	
+	MarkCoreLimits_t limits;
+	MarkCoreStatus_e status;
+	
+	// compressed html, only with cache_compressed
+	int cache_compressed;
+	void *compressed;
+	size_t compressed_size;
+	MarkCoreCompression_e compressed_format;
+	int compressed_level;
+};
+
+#endif
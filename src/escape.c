@@ -0,0 +1,155 @@
+#include "escape.h"
+#include "alloc.h"
+
+#include <string.h>
+
+// replacement per byte, NULL keeps it
+typedef const char *MCEscapeTable_t[256];
+
+static MCEscapeTable_t escape_tables[MC_ESCAPE_KIND_COUNT] = {
+	[MC_ESCAPE_HTML] = {
+		['&'] = "&amp;",
+		['<'] = "&lt;",
+		['>'] = "&gt;",
+		['"'] = "&quot;",
+		['\''] = "&#39;",
+	},
+	[MC_ESCAPE_JSON] = {
+		[0x01] = "\\u0001", [0x02] = "\\u0002", [0x03] = "\\u0003", [0x04] = "\\u0004",
+		[0x05] = "\\u0005", [0x06] = "\\u0006", [0x07] = "\\u0007", ['\b'] = "\\b",
+		['\t'] = "\\t", ['\n'] = "\\n", [0x0b] = "\\u000b", ['\f'] = "\\f",
+		['\r'] = "\\r", [0x0e] = "\\u000e", [0x0f] = "\\u000f", [0x10] = "\\u0010",
+		[0x11] = "\\u0011", [0x12] = "\\u0012", [0x13] = "\\u0013", [0x14] = "\\u0014",
+		[0x15] = "\\u0015", [0x16] = "\\u0016", [0x17] = "\\u0017", [0x18] = "\\u0018",
+		[0x19] = "\\u0019", [0x1a] = "\\u001a", [0x1b] = "\\u001b", [0x1c] = "\\u001c",
+		[0x1d] = "\\u001d", [0x1e] = "\\u001e", [0x1f] = "\\u001f",
+		['"'] = "\\\"",
+		['\\'] = "\\\\",
+	},
+	[MC_ESCAPE_TERMINAL] = {
+		[0x01] = "?", [0x02] = "?", [0x03] = "?", [0x04] = "?", [0x05] = "?", [0x06] = "?",
+		[0x07] = "?", [0x08] = "?", [0x0b] = "?", [0x0c] = "?", [0x0d] = "?", [0x0e] = "?",
+		[0x0f] = "?", [0x10] = "?", [0x11] = "?", [0x12] = "?", [0x13] = "?", [0x14] = "?",
+		[0x15] = "?", [0x16] = "?", [0x17] = "?", [0x18] = "?", [0x19] = "?", [0x1a] = "?",
+		[0x1b] = "?", [0x1c] = "?", [0x1d] = "?", [0x1e] = "?", [0x1f] = "?", [0x7f] = "?",
+	},
+};
+
+/*
+Length of the UTF-8 sequence at text[i], 1 for a byte that doesn't start a valid one. 0 when
+text[i] starts a C1 control instead, with its length in *c1_len: U+0080-U+009F (c2 80 - c2 9f),
+or a raw 0x80-0x9f byte outside any sequence, which 8 bit terminals read as CSI, OSC, ...
+*/
+static size_t terminal_utf8_span(const unsigned char *text, size_t len, size_t i, size_t *c1_len) {
+	unsigned char c = text[i];
+	size_t sequence = c >= 0xf0 && c <= 0xf4 ? 4 : c >= 0xe0 ? 3 : c >= 0xc2 ? 2 : 1;
+	if (c < 0xc2 || c > 0xf4 || i + sequence > len) sequence = 1;
+	for (size_t k = 1; k < sequence; k++) {
+		if ((text[i + k] & 0xc0) != 0x80) sequence = 1;
+	}
+	
+	if (sequence == 2 && c == 0xc2 && text[i + 1] <= 0x9f) {
+		*c1_len = 2;
+		return 0;
+	}
+	if (sequence == 1 && c >= 0x80 && c <= 0x9f) {
+		*c1_len = 1;
+		return 0;
+	}
+	return sequence;
+}
+
+// C0 controls go through the table, C1 controls in either encoding become '?'
+static size_t escape_terminal_to_sink(MCSink_t *sink, const char *text, size_t len) {
+	const char *const *table = escape_tables[MC_ESCAPE_TERMINAL];
+	const unsigned char *bytes = (const unsigned char *)text;
+	
+	size_t written = 0;
+	size_t run = 0;
+	for (size_t i = 0; i < len;) {
+		const char *replacement = table[bytes[i]];
+		size_t replaced = 1;
+		if (bytes[i] >= 0x80) {
+			size_t c1_len = 0;
+			size_t span = terminal_utf8_span(bytes, len, i, &c1_len);
+			if (span) {
+				i += span;
+				continue;
+			}
+			replacement = "?";
+			replaced = c1_len;
+		}
+		if (!replacement) {
+			i++;
+			continue;
+		}
+		
+		written += sink_write(sink, text + run, i - run);
+		written += sink_puts(sink, replacement);
+		i += replaced;
+		run = i;
+	}
+	written += sink_write(sink, text + run, len - run);
+	
+	return written;
+}
+
+size_t escape_to_sink(MCSink_t *sink, MCEscapeKind_e kind, const char *text, size_t len) {
+	if (kind == MC_ESCAPE_TERMINAL) return escape_terminal_to_sink(sink, text, len);
+	
+	const char *const *table = escape_tables[kind];
+	
+	size_t written = 0;
+	size_t run = 0;
+	for (size_t i = 0; i < len; i++) {
+		const char *replacement = table[(unsigned char)text[i]];
+		if (!replacement) continue;
+		
+		written += sink_write(sink, text + run, i - run);
+		written += sink_puts(sink, replacement);
+		run = i + 1;
+	}
+	written += sink_write(sink, text + run, len - run);
+	
+	return written;
+}
+
+static char *escape_copy(MCEscapeKind_e kind, const char *text, size_t len, size_t *out_len) {
+	const char *const *table = escape_tables[kind];
+	
+	size_t escaped_len = 0;
+	int changed = 0;
+	for (size_t i = 0; i < len; i++) {
+		const char *replacement = table[(unsigned char)text[i]];
+		escaped_len += replacement ? strlen(replacement) : 1;
+		if (replacement) changed = 1;
+	}
+	if (!changed) return NULL;
+	
+	char *escaped = mc_malloc(escaped_len + 1);
+	if (!escaped) return NULL;
+	
+	char *out = escaped;
+	for (size_t i = 0; i < len; i++) {
+		const char *replacement = table[(unsigned char)text[i]];
+		if (replacement) {
+			size_t replacement_len = strlen(replacement);
+			memcpy(out, replacement, replacement_len);
+			out += replacement_len;
+		} else {
+			*out++ = text[i];
+		}
+	}
+	*out = '\0';
+	
+	*out_len = escaped_len;
+	return escaped;
+}
+
+char *escape_html_copy(const char *text, size_t len, size_t *out_len) {
+	return escape_copy(MC_ESCAPE_HTML, text, len, out_len);
+}
+
+char *escape_json_copy(const char *text, size_t len, size_t *out_len) {
+	return escape_copy(MC_ESCAPE_JSON, text, len, out_len);
+}
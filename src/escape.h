@@ -0,0 +1,27 @@
+#ifndef MARKCORE_ESCAPE_H
+#define MARKCORE_ESCAPE_H
+
+#include <stdlib.h>
+
+#include "sink.h"
+
+/*
+Escaping kernels shared by the renderers. Each one is a 256 entry replacement table,
+text is scanned for bytes with a replacement and the clean runs between them are
+written with a single sink_write, so mostly clean text costs one scan and one copy.
+*/
+
+typedef enum {
+	MC_ESCAPE_HTML, // & < > " '
+	MC_ESCAPE_JSON, // " \ and control characters, for string literals
+	MC_ESCAPE_TERMINAL, // C0 controls other than \n and \t, DEL and C1 controls raw or as UTF-8 (no injected escape sequences)
+	MC_ESCAPE_KIND_COUNT
+} MCEscapeKind_e;
+
+size_t escape_to_sink(MCSink_t *sink, MCEscapeKind_e kind, const char *text, size_t len);
+
+// MCEscape_f (intern.h) versions, an mc_malloc()ed copy or NULL when nothing needs escaping
+char *escape_html_copy(const char *text, size_t len, size_t *out_len);
+char *escape_json_copy(const char *text, size_t len, size_t *out_len);
+
+#endif
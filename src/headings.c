@@ -0,0 +1,252 @@
+#include "headings.h"
+#include "alloc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define HEADING_INITIAL_BUCKETS 32
+#define TOC_MAX_DEPTH 16
+
+// FNV-1a
+static uint32_t hash_anchor(const char *s) {
+	uint32_t h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+MCHeadingIndex_t *heading_index_create(void) {
+	MCHeadingIndex_t *index = mc_calloc(1, sizeof(MCHeadingIndex_t));
+	if (!index) return NULL;
+	
+	index->anchor_buckets = mc_calloc(HEADING_INITIAL_BUCKETS, sizeof(uint32_t));
+	if (!index->anchor_buckets) {
+		mc_free(index);
+		return NULL;
+	}
+	index->bucket_count = HEADING_INITIAL_BUCKETS;
+	return index;
+}
+
+void heading_index_destroy(MCHeadingIndex_t *index) {
+	if (!index) return;
+	mc_free(index->items);
+	mc_free(index->anchor_buckets);
+	mc_free(index);
+}
+
+size_t heading_index_memory(const MCHeadingIndex_t *index) {
+	if (!index) return 0;
+	return sizeof(MCHeadingIndex_t) + sizeof(MCHeading_t) * index->capacity + sizeof(uint32_t) * index->bucket_count;
+}
+
+// Anchors ======================================================
+
+static int anchor_taken(MCHeadingIndex_t *index, const char *anchor) {
+	size_t slot = hash_anchor(anchor) & (index->bucket_count - 1);
+	while (index->anchor_buckets[slot]) {
+		if (strcmp(index->items[index->anchor_buckets[slot] - 1].anchor, anchor) == 0) return 1;
+		slot = (slot + 1) & (index->bucket_count - 1);
+	}
+	return 0;
+}
+
+static void insert_anchor(uint32_t *buckets, size_t bucket_count, const char *anchor, uint32_t item) {
+	size_t slot = hash_anchor(anchor) & (bucket_count - 1);
+	while (buckets[slot]) slot = (slot + 1) & (bucket_count - 1);
+	buckets[slot] = item + 1;
+}
+
+static int grow_buckets(MCHeadingIndex_t *index) {
+	size_t bucket_count = index->bucket_count * 2;
+	uint32_t *buckets = mc_calloc(bucket_count, sizeof(uint32_t));
+	if (!buckets) return 0;
+	
+	for (size_t i = 0; i < index->count; i++) {
+		insert_anchor(buckets, bucket_count, index->items[i].anchor, (uint32_t)i);
+	}
+	
+	mc_free(index->anchor_buckets);
+	index->anchor_buckets = buckets;
+	index->bucket_count = bucket_count;
+	return 1;
+}
+
+// lowercase ascii alphanumerics, keep utf-8 bytes, '-' / '_', spaces become '-', everything else dropped
+static char *slugify(const char *text, size_t len) {
+	char *slug = mc_malloc(len + 1);
+	if (!slug) return NULL;
+	
+	size_t n = 0;
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)text[i];
+		if (c >= 'A' && c <= 'Z') {
+			slug[n++] = (char)(c - 'A' + 'a');
+		} else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c >= 0x80) {
+			slug[n++] = (char)c;
+		} else if (c == ' ' || c == '\t') {
+			slug[n++] = '-';
+		}
+	}
+	slug[n] = '\0';
+	
+	if (n == 0) {
+		mc_free(slug);
+		return mc_strdup("section");
+	}
+	
+	// dropped bytes leave slack, trim it so the anchor is an exact strlen + 1 copy
+	if (n < len) {
+		char *trimmed = mc_realloc(slug, n + 1);
+		if (trimmed) slug = trimmed;
+	}
+	return slug;
+}
+
+static char *unique_anchor(MCHeadingIndex_t *index, char *slug) {
+	if (!anchor_taken(index, slug)) return slug;
+	
+	size_t len = strlen(slug);
+	char *anchor = mc_malloc(len + 24);
+	if (!anchor) {
+		mc_free(slug);
+		return NULL;
+	}
+	
+	for (unsigned long n = 1;; n++) {
+		snprintf(anchor, len + 24, "%s-%lu", slug, n);
+		if (!anchor_taken(index, anchor)) break;
+	}
+	
+	mc_free(slug);
+	char *trimmed = mc_realloc(anchor, strlen(anchor) + 1);
+	return trimmed ? trimmed : anchor;
+}
+
+// Index ======================================================
+
+int heading_index_add(MCHeadingIndex_t *index, MCNode_t *header_node, size_t block) {
+	if (!index || !header_node || header_node->type != HEADER_NODE) return 0;
+	
+	const char *text = header_node->content ? header_node->content : "";
+	const char *end = text + strlen(text);
+	while (*text == ' ' || *text == '\t') text++;
+	while (end > text && (end[-1] == ' ' || end[-1] == '\t')) end--;
+	
+	if (!header_node->data) {
+		char *slug = slugify(text, end - text);
+		if (!slug) return 0;
+		header_node->data = unique_anchor(index, slug);
+		if (!header_node->data) return 0;
+	}
+	
+	if (index->count == index->capacity) {
+		size_t capacity = index->capacity ? index->capacity * 2 : 8;
+		MCHeading_t *items = mc_realloc(index->items, sizeof(MCHeading_t) * capacity);
+		if (!items) return 0;
+		index->items = items;
+		index->capacity = capacity;
+	}
+	if ((index->count + 1) * 2 > index->bucket_count && !grow_buckets(index)) return 0;
+	
+	MCHeading_t *heading = &index->items[index->count];
+	heading->level = header_node->header_level;
+	heading->text = text;
+	heading->text_len = end - text;
+	heading->anchor = header_node->data;
+	heading->node = header_node;
+	heading->block = block;
+	heading->section_end = block + 1;
+	
+	insert_anchor(index->anchor_buckets, index->bucket_count, heading->anchor, (uint32_t)index->count);
+	index->count++;
+	
+	return 1;
+}
+
+void heading_index_finish(MCHeadingIndex_t *index, size_t block_count) {
+	if (!index) return;
+	
+	// walk backwards keeping the next heading at each level or above
+	size_t next_at_level[TOC_MAX_DEPTH + 1];
+	for (int level = 0; level <= TOC_MAX_DEPTH; level++) next_at_level[level] = block_count;
+	
+	for (size_t i = index->count; i-- > 0;) {
+		MCHeading_t *heading = &index->items[i];
+		int level = heading->level < 1 ? 1 : (heading->level > TOC_MAX_DEPTH ? TOC_MAX_DEPTH : heading->level);
+		
+		heading->section_end = next_at_level[level];
+		for (int deeper = level; deeper <= TOC_MAX_DEPTH; deeper++) {
+			next_at_level[deeper] = heading->block;
+		}
+	}
+}
+
+// TOC ======================================================
+
+#define SAFE_TOC_CALL(r, fn, ...) \
+	do { \
+		if ((r)->fn) bytes_written += (r)->fn((r), ##__VA_ARGS__); \
+	} while (0)
+
+static size_t render_toc_entry(Renderer_t *r, MCHeading_t *heading) {
+	size_t bytes_written = 0;
+	
+	size_t anchor_len = strlen(heading->anchor);
+	char *href = mc_malloc(anchor_len + 2);
+	char *text = mc_malloc(heading->text_len + 1);
+	
+	if (href && text) {
+		href[0] = '#';
+		memcpy(href + 1, heading->anchor, anchor_len + 1);
+		memcpy(text, heading->text, heading->text_len);
+		text[heading->text_len] = '\0';
+		
+		SAFE_TOC_CALL(r, render_list_item_open);
+		SAFE_TOC_CALL(r, render_link, href, text);
+	}
+	
+	mc_free(href);
+	mc_free(text);
+	return bytes_written;
+}
+
+size_t render_heading_toc(Renderer_t *r, MCHeadingIndex_t *index) {
+	if (!r || !index || index->count == 0) return 0;
+	
+	size_t bytes_written = 0;
+	
+	// level of the open list at each depth, every open list has one open item
+	int levels[TOC_MAX_DEPTH];
+	int depth = 0;
+	
+	for (size_t i = 0; i < index->count; i++) {
+		MCHeading_t *heading = &index->items[i];
+		
+		if (depth == 0 || (heading->level > levels[depth - 1] && depth < TOC_MAX_DEPTH)) {
+			SAFE_TOC_CALL(r, render_unordered_list_open);
+			levels[depth++] = heading->level;
+		} else {
+			while (depth > 1 && heading->level <= levels[depth - 2]) {
+				SAFE_TOC_CALL(r, render_list_item_close);
+				SAFE_TOC_CALL(r, render_unordered_list_close);
+				depth--;
+			}
+			SAFE_TOC_CALL(r, render_list_item_close);
+			if (heading->level < levels[depth - 1]) levels[depth - 1] = heading->level;
+		}
+		
+		bytes_written += render_toc_entry(r, heading);
+	}
+	
+	while (depth > 0) {
+		SAFE_TOC_CALL(r, render_list_item_close);
+		SAFE_TOC_CALL(r, render_unordered_list_close);
+		depth--;
+	}
+	SAFE_TOC_CALL(r, render_line_end);
+	
+	return bytes_written;
+}
@@ -0,0 +1,52 @@
+#ifndef MARKCORE_HEADINGS_H
+#define MARKCORE_HEADINGS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "renderer.h"
+
+/*
+Ordered heading index, filled by the parser as HEADER_NODEs are created.
+Each heading gets a slug anchor ("Getting Started" -> "getting-started", repeats
+become "getting-started-1", ...) stored in the header node's data, which is
+where renderers pick up the id attribute.
+*/
+
+typedef struct {
+	int level;
+	const char *text; // trimmed span inside node->content, not NUL terminated at text_len
+	size_t text_len;
+	const char *anchor; // node->data
+	MCNode_t *node;
+	
+	size_t block; // top level block holding the header
+	size_t section_end; // first block after the section (next heading of the same or higher level)
+} MCHeading_t;
+
+typedef struct MCHeadingIndex {
+	MCHeading_t *items;
+	size_t count;
+	size_t capacity;
+	
+	uint32_t *anchor_buckets; // item index + 1, 0 is empty
+	size_t bucket_count;
+} MCHeadingIndex_t;
+
+MCHeadingIndex_t *heading_index_create(void);
+void heading_index_destroy(MCHeadingIndex_t *index);
+
+// Registers the header, assigning a unique anchor unless node->data already has one
+int heading_index_add(MCHeadingIndex_t *index, MCNode_t *header_node, size_t block);
+
+// Bytes held by the index, anchors belong to the header nodes
+size_t heading_index_memory(const MCHeadingIndex_t *index);
+
+// Resolve section ends once every block is known
+void heading_index_finish(MCHeadingIndex_t *index, size_t block_count);
+
+// Nested unordered list of links to each heading anchor
+size_t render_heading_toc(Renderer_t *r, MCHeadingIndex_t *index);
+
+#endif
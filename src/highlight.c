@@ -0,0 +1,148 @@
+#include "highlight.h"
+#include "alloc.h"
+
+#include <string.h>
+
+#define HIGHLIGHT_CACHE_INITIAL_SLOTS 64
+
+// FNV-1a over the language, a NUL separator and the code
+static uint64_t hash_bytes(uint64_t h, const char *s, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static uint64_t hash_snippet(const char *lang, size_t lang_len, const char *code, size_t len) {
+	uint64_t h = hash_bytes(14695981039346656037ull, lang, lang_len);
+	h = hash_bytes(h, "", 1);
+	return hash_bytes(h, code, len);
+}
+
+MCHighlightCache_t *highlight_cache_create(size_t max_bytes) {
+	MCHighlightCache_t *cache = mc_calloc(1, sizeof(MCHighlightCache_t));
+	if (!cache) return NULL;
+	
+	cache->slots = mc_calloc(HIGHLIGHT_CACHE_INITIAL_SLOTS, sizeof(MCHighlightEntry_t));
+	if (!cache->slots) {
+		mc_free(cache);
+		return NULL;
+	}
+	cache->slot_count = HIGHLIGHT_CACHE_INITIAL_SLOTS;
+	cache->max_bytes = max_bytes;
+	return cache;
+}
+
+static void cache_clear(MCHighlightCache_t *cache) {
+	for (size_t i = 0; i < cache->slot_count; i++) {
+		mc_free(cache->slots[i].bytes);
+		cache->slots[i].bytes = NULL;
+	}
+	cache->count = 0;
+	cache->bytes = 0;
+}
+
+void highlight_cache_destroy(MCHighlightCache_t *cache) {
+	if (!cache) return;
+	
+	cache_clear(cache);
+	mc_free(cache->slots);
+	mc_free(cache);
+}
+
+// slot holding the snippet, or the empty slot where it goes
+static MCHighlightEntry_t *cache_slot(MCHighlightCache_t *cache, uint64_t hash,
+									  const char *lang, size_t lang_len,
+									  const char *code, size_t len) {
+	size_t mask = cache->slot_count - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		MCHighlightEntry_t *entry = &cache->slots[i];
+		if (!entry->bytes) return entry;
+		if (entry->hash == hash && entry->lang_len == lang_len && entry->code_len == len &&
+			memcmp(entry->bytes, lang, lang_len) == 0 &&
+			memcmp(entry->bytes + lang_len + 1, code, len) == 0) {
+			return entry;
+		}
+	}
+}
+
+static int cache_grow(MCHighlightCache_t *cache) {
+	size_t slot_count = cache->slot_count * 2;
+	MCHighlightEntry_t *slots = mc_calloc(slot_count, sizeof(MCHighlightEntry_t));
+	if (!slots) return 0;
+	
+	for (size_t i = 0; i < cache->slot_count; i++) {
+		MCHighlightEntry_t *entry = &cache->slots[i];
+		if (!entry->bytes) continue;
+		size_t j = entry->hash & (slot_count - 1);
+		while (slots[j].bytes) j = (j + 1) & (slot_count - 1);
+		slots[j] = *entry;
+	}
+	
+	mc_free(cache->slots);
+	cache->slots = slots;
+	cache->slot_count = slot_count;
+	return 1;
+}
+
+// copy of the html owned by the cache, NULL when it wasn't kept
+static const char *cache_insert(MCHighlightCache_t *cache, uint64_t hash,
+								const char *lang, size_t lang_len,
+								const char *code, size_t len,
+								const char *html, size_t html_len) {
+	size_t size = lang_len + 1 + len + html_len;
+	if (cache->max_bytes && size > cache->max_bytes) return NULL;
+	if (cache->max_bytes && cache->bytes + size > cache->max_bytes) cache_clear(cache);
+	if ((cache->count + 1) * 4 > cache->slot_count * 3 && !cache_grow(cache)) return NULL;
+	
+	char *bytes = mc_malloc(size);
+	if (!bytes) return NULL;
+	memcpy(bytes, lang, lang_len);
+	bytes[lang_len] = '\0';
+	memcpy(bytes + lang_len + 1, code, len);
+	memcpy(bytes + lang_len + 1 + len, html, html_len);
+	
+	MCHighlightEntry_t *entry = cache_slot(cache, hash, lang, lang_len, code, len);
+	*entry = (MCHighlightEntry_t){hash, bytes, lang_len, len, html_len};
+	cache->count++;
+	cache->bytes += size;
+	return bytes + lang_len + 1 + len;
+}
+
+const char *highlight_code(const MCHighlighter_t *h,
+						   const char *lang,
+						   const char *code,
+						   size_t len,
+						   size_t *out_len,
+						   char **owned) {
+	*owned = NULL;
+	if (!lang) lang = "";
+	size_t lang_len = strlen(lang);
+	
+	MCHighlightCache_t *cache = h->cache;
+	uint64_t hash = 0;
+	if (cache) {
+		hash = hash_snippet(lang, lang_len, code, len);
+		MCHighlightEntry_t *entry = cache_slot(cache, hash, lang, lang_len, code, len);
+		if (entry->bytes) {
+			cache->hits++;
+			*out_len = entry->html_len;
+			return entry->bytes + entry->lang_len + 1 + entry->code_len;
+		}
+		cache->misses++;
+	}
+	
+	size_t html_len = 0;
+	char *html = h->highlight(code, len, lang, &html_len, h->userdata);
+	if (!html) return NULL;
+	*out_len = html_len;
+	
+	const char *cached = cache ? cache_insert(cache, hash, lang, lang_len, code, len, html, html_len) : NULL;
+	if (!cached) {
+		*owned = html;
+		return html;
+	}
+	free(html);
+	return cached;
+}
@@ -0,0 +1,58 @@
+#ifndef MARKCORE_HIGHLIGHT_H
+#define MARKCORE_HIGHLIGHT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "markcore.h"
+
+/*
+Code block highlighting. The caller's highlight callback turns code into HTML, and the
+optional cache keeps that HTML by a hash of language and code, so a snippet repeated
+across documents is highlighted once. Entries hold their key bytes too, hashes are only
+used to find them. The cache is bounded: an insert that would pass max_bytes empties it
+first. Like the shared string table it is not thread safe, one render at a time, so
+snapshots (rendered on their own threads) keep the callback but never get the cache.
+*/
+
+typedef struct {
+	uint64_t hash;
+	char *bytes; // language, NUL, code, then the html. NULL for an empty slot
+	size_t lang_len;
+	size_t code_len;
+	size_t html_len;
+} MCHighlightEntry_t;
+
+struct MCHighlightCache {
+	MCHighlightEntry_t *slots; // open addressing
+	size_t slot_count; // power of two
+	size_t count;
+	
+	size_t bytes; // key and html bytes held
+	size_t max_bytes; // 0 for unbounded
+	
+	size_t hits;
+	size_t misses;
+};
+
+typedef struct {
+	MarkCoreHighlight_f highlight;
+	void *userdata;
+	MCHighlightCache_t *cache; // optional
+} MCHighlighter_t;
+
+MCHighlightCache_t *highlight_cache_create(size_t max_bytes);
+void highlight_cache_destroy(MCHighlightCache_t *cache);
+
+/*
+Highlighted HTML for code, NULL when the callback declined. *owned is set when the result
+came straight from the callback, free() it. Cached results stay valid until the next call.
+*/
+const char *highlight_code(const MCHighlighter_t *h,
+						   const char *lang,
+						   const char *code,
+						   size_t len,
+						   size_t *out_len,
+						   char **owned);
+
+#endif
@@ -0,0 +1,120 @@
+#include "html_template.h"
+#include "alloc.h"
+
+#include <string.h>
+
+static const char *slot_names[MC_SLOT_COUNT] = {
+	[MC_SLOT_SOURCEPOS] = "sourcepos",
+	[MC_SLOT_LEVEL] = "level",
+	[MC_SLOT_ID] = "id",
+	[MC_SLOT_TEXT] = "text",
+	[MC_SLOT_URL] = "url",
+	[MC_SLOT_ALIGN] = "align",
+	[MC_SLOT_LANG] = "lang",
+};
+
+static MCTemplateSlot_e find_slot(const char *name, size_t len) {
+	for (int slot = MC_SLOT_NONE + 1; slot < MC_SLOT_COUNT; slot++) {
+		if (strlen(slot_names[slot]) == len && memcmp(slot_names[slot], name, len) == 0) return slot;
+	}
+	return MC_SLOT_NONE;
+}
+
+static void part_release(MCTemplatePart_t *part) {
+	mc_free(part->bytes);
+	mc_free(part->segments);
+	memset(part, 0, sizeof(MCTemplatePart_t));
+}
+
+/*
+Literals never grow past the source, and every placeholder takes at least "{x}" so there
+are at most len / 3 + 1 segments: both buffers are sized up front. "{{" is a literal brace.
+*/
+static int part_compile(MCTemplatePart_t *part, const char *source) {
+	size_t len = strlen(source);
+	if (len > UINT32_MAX) return 0;
+	
+	part->bytes = mc_malloc(len + 1);
+	part->segments = mc_malloc((len / 3 + 1) * sizeof(MCTemplateSegment_t));
+	part->count = 0;
+	if (!part->bytes || !part->segments) {
+		part_release(part);
+		return 0;
+	}
+	
+	uint32_t written = 0;
+	uint32_t literal_start = 0;
+	const char *p = source;
+	
+	while (*p) {
+		if (*p != '{') {
+			part->bytes[written++] = *p++;
+			continue;
+		}
+		if (p[1] == '{') {
+			part->bytes[written++] = '{';
+			p += 2;
+			continue;
+		}
+		
+		const char *end = strchr(p + 1, '}');
+		MCTemplateSlot_e slot = end ? find_slot(p + 1, end - p - 1) : MC_SLOT_NONE;
+		if (slot == MC_SLOT_NONE) {
+			part_release(part);
+			return 0;
+		}
+		
+		part->segments[part->count++] = (MCTemplateSegment_t){literal_start, written - literal_start, slot};
+		literal_start = written;
+		p = end + 1;
+	}
+	
+	if (written > literal_start || part->count == 0) {
+		part->segments[part->count++] = (MCTemplateSegment_t){literal_start, written - literal_start, MC_SLOT_NONE};
+	}
+	return 1;
+}
+
+MCHtmlTemplate_t *html_template_create(void) {
+	return mc_calloc(1, sizeof(MCHtmlTemplate_t));
+}
+
+void html_template_destroy(MCHtmlTemplate_t *t) {
+	if (!t) return;
+	
+	for (int i = 0; i < MARKCORE_TEMPLATE_COUNT; i++) {
+		part_release(&t->parts[i][0]);
+		part_release(&t->parts[i][1]);
+	}
+	mc_free(t);
+}
+
+int html_template_set(MCHtmlTemplate_t *t, MarkCoreTemplateElement_e element, const char *open, const char *close) {
+	if (!t || element < 0 || element >= MARKCORE_TEMPLATE_COUNT) return 0;
+	
+	MCTemplatePart_t compiled[2] = {0};
+	if (!part_compile(&compiled[0], open ? open : "") || !part_compile(&compiled[1], close ? close : "")) {
+		part_release(&compiled[0]);
+		return 0;
+	}
+	
+	part_release(&t->parts[element][0]);
+	part_release(&t->parts[element][1]);
+	t->parts[element][0] = compiled[0];
+	t->parts[element][1] = compiled[1];
+	t->set[element] = 1;
+	return 1;
+}
+
+size_t html_template_emit(MCSink_t *sink, const MCTemplatePart_t *part, const MCTemplateValues_t values) {
+	size_t written = 0;
+	
+	for (size_t i = 0; i < part->count; i++) {
+		const MCTemplateSegment_t *segment = &part->segments[i];
+		if (segment->len) written += sink_write(sink, part->bytes + segment->offset, segment->len);
+		
+		const char *value = values[segment->slot];
+		if (segment->slot != MC_SLOT_NONE && value) written += sink_puts(sink, value);
+	}
+	return written;
+}
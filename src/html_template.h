@@ -0,0 +1,56 @@
+#ifndef MARKCORE_HTML_TEMPLATE_H
+#define MARKCORE_HTML_TEMPLATE_H
+
+#include <stdint.h>
+
+#include "markcore.h"
+#include "sink.h"
+
+/*
+Compiled HTML templates. Each open/close string is split once into literal segments,
+each followed by an optional placeholder slot, so rendering is a run of sink_write calls
+on precomputed bytes with the slot values in between, no parsing or formatting per node.
+Elements that were never set keep the built-in html renderer callbacks.
+*/
+
+typedef enum {
+	MC_SLOT_NONE,
+	MC_SLOT_SOURCEPOS, // whole data-sourcepos attribute with its leading space, or nothing
+	MC_SLOT_LEVEL,
+	MC_SLOT_ID,
+	MC_SLOT_TEXT,
+	MC_SLOT_URL,
+	MC_SLOT_ALIGN, // whole align attribute with its leading space, or nothing
+	MC_SLOT_LANG, // escaped
+	MC_SLOT_COUNT
+} MCTemplateSlot_e;
+
+typedef struct {
+	uint32_t offset; // literal bytes in the part's buffer
+	uint32_t len;
+	MCTemplateSlot_e slot; // written after the literal
+} MCTemplateSegment_t;
+
+typedef struct {
+	char *bytes;
+	MCTemplateSegment_t *segments;
+	size_t count;
+} MCTemplatePart_t;
+
+struct MCHtmlTemplate {
+	MCTemplatePart_t parts[MARKCORE_TEMPLATE_COUNT][2]; // open, close
+	int set[MARKCORE_TEMPLATE_COUNT];
+};
+
+// Slot values of one emit, NULL writes nothing
+typedef const char *MCTemplateValues_t[MC_SLOT_COUNT];
+
+MCHtmlTemplate_t *html_template_create(void);
+void html_template_destroy(MCHtmlTemplate_t *t);
+
+// 0 on an unknown placeholder or allocation failure, the element keeps what it had
+int html_template_set(MCHtmlTemplate_t *t, MarkCoreTemplateElement_e element, const char *open, const char *close);
+
+size_t html_template_emit(MCSink_t *sink, const MCTemplatePart_t *part, const MCTemplateValues_t values);
+
+#endif
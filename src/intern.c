@@ -0,0 +1,183 @@
+#include "intern.h"
+#include "alloc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define INTERN_CHUNK_SIZE (16 * 1024)
+#define INTERN_INITIAL_BUCKETS 256
+
+struct MCInternChunk {
+	struct MCInternChunk *next;
+	size_t used;
+	size_t size;
+	char data[];
+};
+
+size_t intern_table_memory(const MCInternTable_t *t) {
+	if (!t) return 0;
+	
+	size_t bytes = sizeof(MCInternTable_t) + sizeof(MCInternEntry_t) * t->capacity + sizeof(uint32_t) * t->bucket_count;
+	for (MCInternChunk_t *chunk = t->chunks; chunk; chunk = chunk->next) {
+		bytes += sizeof(MCInternChunk_t) + chunk->size;
+	}
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (t->entries[i].escaped && t->entries[i].escaped != t->entries[i].text) bytes += t->entries[i].escaped_len + 1;
+	}
+	return bytes;
+}
+
+// FNV-1a
+static uint32_t hash_span(const char *s, size_t len) {
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+MCInternTable_t *intern_table_create(void) {
+	MCInternTable_t *t = mc_calloc(1, sizeof(MCInternTable_t));
+	if (!t) return NULL;
+	
+	t->buckets = mc_calloc(INTERN_INITIAL_BUCKETS, sizeof(uint32_t));
+	if (!t->buckets) {
+		mc_free(t);
+		return NULL;
+	}
+	t->bucket_count = INTERN_INITIAL_BUCKETS;
+	return t;
+}
+
+void intern_table_destroy(MCInternTable_t *t) {
+	if (!t) return;
+	
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (t->entries[i].escaped && t->entries[i].escaped != t->entries[i].text) {
+			mc_free((char *)t->entries[i].escaped);
+		}
+	}
+	
+	MCInternChunk_t *chunk = t->chunks;
+	while (chunk) {
+		MCInternChunk_t *next = chunk->next;
+		mc_free(chunk);
+		chunk = next;
+	}
+	
+	mc_free(t->entries);
+	mc_free(t->buckets);
+	mc_free(t);
+}
+
+// Arena ======================================================
+
+static char *arena_copy(MCInternTable_t *t, const char *text, size_t len) {
+	MCInternChunk_t *chunk = t->chunks;
+	
+	if (!chunk || chunk->size - chunk->used < len + 1) {
+		// oversized strings get a chunk of their own
+		size_t size = len + 1 > INTERN_CHUNK_SIZE ? len + 1 : INTERN_CHUNK_SIZE;
+		chunk = mc_malloc(sizeof(MCInternChunk_t) + size);
+		if (!chunk) return NULL;
+		chunk->used = 0;
+		chunk->size = size;
+		chunk->next = t->chunks;
+		t->chunks = chunk;
+	}
+	
+	char *copy = chunk->data + chunk->used;
+	memcpy(copy, text, len);
+	copy[len] = '\0';
+	chunk->used += len + 1;
+	t->bytes += len + 1;
+	return copy;
+}
+
+// Table ======================================================
+
+static int grow_buckets(MCInternTable_t *t) {
+	size_t bucket_count = t->bucket_count * 2;
+	uint32_t *buckets = mc_calloc(bucket_count, sizeof(uint32_t));
+	if (!buckets) return 0;
+	
+	for (uint32_t i = 0; i < t->count; i++) {
+		size_t slot = t->entries[i].hash & (bucket_count - 1);
+		while (buckets[slot]) slot = (slot + 1) & (bucket_count - 1);
+		buckets[slot] = i + 1;
+	}
+	
+	mc_free(t->buckets);
+	t->buckets = buckets;
+	t->bucket_count = bucket_count;
+	return 1;
+}
+
+uint32_t intern_table_add(MCInternTable_t *t, const char *text, size_t len) {
+	if (!t || !text) return MC_NO_STRING_ID;
+	
+	uint32_t hash = hash_span(text, len);
+	size_t slot = hash & (t->bucket_count - 1);
+	
+	while (t->buckets[slot]) {
+		MCInternEntry_t *entry = &t->entries[t->buckets[slot] - 1];
+		if (entry->hash == hash && entry->len == len && memcmp(entry->text, text, len) == 0) {
+			return t->buckets[slot] - 1;
+		}
+		slot = (slot + 1) & (t->bucket_count - 1);
+	}
+	
+	if (t->count == MC_NO_STRING_ID - 1) return MC_NO_STRING_ID;
+	
+	// keep load factor under 1/2
+	if ((size_t)(t->count + 1) * 2 > t->bucket_count) {
+		if (!grow_buckets(t)) return MC_NO_STRING_ID;
+		return intern_table_add(t, text, len);
+	}
+	
+	if (t->count == t->capacity) {
+		uint32_t capacity = t->capacity ? t->capacity * 2 : 64;
+		MCInternEntry_t *entries = mc_realloc(t->entries, sizeof(MCInternEntry_t) * capacity);
+		if (!entries) return MC_NO_STRING_ID;
+		t->entries = entries;
+		t->capacity = capacity;
+	}
+	
+	char *copy = arena_copy(t, text, len);
+	if (!copy) return MC_NO_STRING_ID;
+	
+	MCInternEntry_t *entry = &t->entries[t->count];
+	memset(entry, 0, sizeof(MCInternEntry_t));
+	entry->text = copy;
+	entry->len = len;
+	entry->hash = hash;
+	
+	t->buckets[slot] = t->count + 1;
+	return t->count++;
+}
+
+const char *intern_table_get(MCInternTable_t *t, uint32_t id) {
+	if (!t || id >= t->count) return NULL;
+	return t->entries[id].text;
+}
+
+const char *intern_table_escaped(MCInternTable_t *t, uint32_t id, MCEscape_f escape, size_t *out_len) {
+	if (!t || id >= t->count || !escape) return NULL;
+	
+	MCInternEntry_t *entry = &t->entries[id];
+	
+	// a table shared between renderers may see more than one escaper, last one wins
+	if (!entry->escaped || entry->escaped_with != escape) {
+		if (entry->escaped && entry->escaped != entry->text) mc_free((char *)entry->escaped);
+		
+		size_t escaped_len = 0;
+		char *escaped = escape(entry->text, entry->len, &escaped_len);
+		entry->escaped = escaped ? escaped : entry->text;
+		entry->escaped_len = escaped ? escaped_len : entry->len;
+		entry->escaped_with = escape;
+	}
+	
+	if (out_len) *out_len = entry->escaped_len;
+	return entry->escaped;
+}
@@ -0,0 +1,60 @@
+#ifndef MARKCORE_INTERN_H
+#define MARKCORE_INTERN_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+String intern table. Identical node strings (repeated urls, inline code identifiers,
+short text runs) are stored once in an append only arena and referenced by id, so
+pointers stay valid for the table's lifetime. Each entry can also cache an escaped
+form, so renderers escape a unique string once no matter how often it appears.
+
+A table is either per document or shared between documents. It is not thread safe:
+one parse at a time, and the escape cache is filled lazily during rendering.
+*/
+
+#define MC_NO_STRING_ID UINT32_MAX
+
+// Returns an mc_malloc()ed escaped copy, or NULL when text needs no escaping
+typedef char *(*MCEscape_f)(const char *text, size_t len, size_t *out_len);
+
+typedef struct {
+	const char *text;
+	size_t len;
+	uint32_t hash;
+	
+	const char *escaped; // NULL until requested, text itself when nothing needed escaping
+	size_t escaped_len;
+	MCEscape_f escaped_with;
+} MCInternEntry_t;
+
+typedef struct MCInternChunk MCInternChunk_t;
+
+typedef struct MCInternTable {
+	MCInternEntry_t *entries;
+	uint32_t count;
+	uint32_t capacity;
+	
+	uint32_t *buckets; // entry id + 1, 0 is empty
+	size_t bucket_count; // power of two
+	
+	MCInternChunk_t *chunks;
+	size_t bytes; // arena bytes in use, for reporting
+} MCInternTable_t;
+
+MCInternTable_t *intern_table_create(void);
+void intern_table_destroy(MCInternTable_t *t);
+
+// id of the string, copying it into the table the first time it's seen
+uint32_t intern_table_add(MCInternTable_t *t, const char *text, size_t len);
+
+const char *intern_table_get(MCInternTable_t *t, uint32_t id);
+
+// Bytes held: entries, buckets, the arena chunks and cached escaped copies
+size_t intern_table_memory(const MCInternTable_t *t);
+
+// Escaped form of an entry, built with escape on first use and cached
+const char *intern_table_escaped(MCInternTable_t *t, uint32_t id, MCEscape_f escape, size_t *out_len);
+
+#endif
@@ -1,11 +1,23 @@
 
 #include "markcore.h"
+#include "alloc.h"
 #include "parser.h"
 #include "types.h"
+#include "document.h"
+#include "serialize.h"
+#include "deflate_sink.h"
+#include "tokens.h"
+#include "html_template.h"
+#include "plugin.h"
 
 #include "renderers/html_renderer.h"
+#include "renderers/text_renderer.h"
+#include "renderers/json_renderer.h"
+#include "renderers/ansi_renderer.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Public ===========================================
 
@@ -16,7 +28,10 @@ size_t markcore_render_to_file(const char *markdown, size_t length, FILE *out_fi
 	MCNode_t *node = markcore_parse(markdown, length);
 // 	markcore_print_tree(node, 0);
     
-	Renderer_t *html_renderer = create_html_renderer(out_file);
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *html_renderer = create_html_renderer(&sink);
 	if (!html_renderer) {
 		fprintf(stderr, "Failed to make HTML renderer\n");
 		return 0;
@@ -30,6 +45,747 @@ size_t markcore_render_to_file(const char *markdown, size_t length, FILE *out_fi
 	return bytes_written;
 }
 
+// Documents ===========================================
+
+static Renderer_t *create_format_renderer(MCDocument_t *doc, MarkCoreFormat_e format, MCSink_t *sink) {
+	Renderer_t *r;
+	switch (format) {
+		case MARKCORE_FORMAT_TEXT: r = create_text_renderer(sink); break;
+		case MARKCORE_FORMAT_JSON: r = create_json_renderer(sink); break;
+		case MARKCORE_FORMAT_ANSI: r = create_ansi_renderer(sink); break;
+		default: r = create_html_renderer(sink); break;
+	}
+	if (!r) {
+		fprintf(stderr, "Failed to make renderer\n");
+		return NULL;
+	}
+	r->max_output_bytes = doc->limits.max_output_bytes;
+	r->strings = doc->strings;
+	if (format == MARKCORE_FORMAT_HTML && doc->sourcepos_attributes) r->lines = doc->lines;
+	if (format == MARKCORE_FORMAT_HTML && doc->highlighter.highlight) r->highlighter = &doc->highlighter;
+	return r;
+}
+
+static Renderer_t *create_document_renderer(MCDocument_t *doc, MCSink_t *sink) {
+	return create_format_renderer(doc, MARKCORE_FORMAT_HTML, sink);
+}
+
+static void finish_document_render(MCDocument_t *doc, Renderer_t *r) {
+	if (r->truncated && doc->status == MARKCORE_OK) doc->status = MARKCORE_LIMIT_OUTPUT;
+	renderer_destroy(r);
+}
+
+static MCDocument_t *document_create(void) {
+	MCDocument_t *doc = mc_calloc(1, sizeof(MCDocument_t));
+	if (doc) atomic_init(&doc->refcount, 1);
+	return doc;
+}
+
+// headings sit at the top level or in container blocks, never inside paragraphs or tables
+static void index_block_headings(MCHeadingIndex_t *index, MCNode_t *node, size_t block, int assign_anchors) {
+	switch (node->type) {
+		case HEADER_NODE:
+			if (node->data || assign_anchors) heading_index_add(index, node, block);
+			return;
+		case BLOCKQUOTE_NODE:
+		case UNORDERED_LIST_NODE:
+		case ORDERED_LIST_NODE:
+		case LIST_ITEM_NODE:
+			for (int i = 0; i < node->child_count; i++) {
+				index_block_headings(index, node->children[i], block, assign_anchors);
+			}
+			return;
+		default:
+			return;
+	}
+}
+
+// Rebuilds the index from the tree. Headers without an anchor get one with assign_anchors,
+// so only pass it when those nodes aren't shared
+static void index_headings(MCDocument_t *doc, int assign_anchors) {
+	heading_index_destroy(doc->headings);
+	doc->headings = NULL;
+	MCNode_t *root = doc->root;
+	
+	// new headers may sit before kept ones, so every kept anchor is reserved before any new
+	// one is made, and the index itself is built in document order afterwards
+	if (assign_anchors) {
+		MCHeadingIndex_t *reserved = heading_index_create();
+		if (!reserved) return;
+		for (int i = 0; i < root->child_count; i++) index_block_headings(reserved, root->children[i], i, 0);
+		// kept headers go in twice, which only costs the reserved index a slot each
+		for (int i = 0; i < root->child_count; i++) index_block_headings(reserved, root->children[i], i, 1);
+		heading_index_destroy(reserved);
+	}
+	
+	doc->headings = heading_index_create();
+	if (!doc->headings) return;
+	
+	for (int i = 0; i < root->child_count; i++) {
+		index_block_headings(doc->headings, root->children[i], i, 0);
+	}
+	heading_index_finish(doc->headings, root->child_count);
+}
+
+MCDocument_t *markcore_document_parse(const char *markdown, size_t length) {
+	return markcore_document_parse_with_options(markdown, length, NULL);
+}
+
+MCDocument_t *markcore_document_parse_with_options(const char *markdown, size_t length, const MarkCoreOptions_t *options) {
+	if (!markdown) return NULL;
+	
+	MCDocument_t *doc = document_create();
+	if (!doc) return NULL;
+	
+	MCParserContext_t context = {0};
+	
+	if (options) {
+		doc->limits = options->limits;
+		context.limits = options->limits;
+		doc->cache_compressed = options->cache_compressed;
+		context.inline_profile = options->inline_profile;
+		context.inline_profile_userdata = options->inline_profile_userdata;
+		doc->highlighter.highlight = options->highlight;
+		doc->highlighter.userdata = options->highlight_userdata;
+		doc->highlighter.cache = options->highlight_cache;
+	}
+	
+	if (options && (options->source_positions || options->sourcepos_attributes)) {
+		doc->lines = block_index_create();
+		doc->sourcepos_attributes = options->sourcepos_attributes;
+		context.positions = 1;
+		context.lines = doc->lines;
+	}
+	
+	doc->blocks = block_index_create();
+	context.blocks = doc->blocks;
+	
+	if (options && (options->url_rewrite || options->url_rewrite_batch)) {
+		doc->urls = url_table_create(options->url_rewrite, options->url_rewrite_batch, options->url_rewrite_userdata);
+		context.urls = doc->urls;
+	}
+	
+	if (options && options->shared_strings) {
+		doc->strings = options->shared_strings;
+	} else if (options && options->intern_strings) {
+		doc->strings = intern_table_create();
+		doc->owns_strings = 1;
+	}
+	context.strings = doc->strings;
+	
+	if (options && options->heading_ids) {
+		doc->headings = heading_index_create();
+		context.headings = doc->headings;
+	}
+	
+	doc->root = markcore_parse_with_context(&context, markdown, length);
+	if (!doc->root) {
+		markcore_document_free(doc);
+		return NULL;
+	}
+	doc->status = context.status;
+	
+	if (options && options->shrink_to_fit) (void)markcore_document_shrink(doc);
+	
+	return doc;
+}
+
+size_t markcore_document_render_to_file(MCDocument_t *doc, FILE *out_file) {
+	return markcore_document_render_with_passes(doc, NULL, out_file);
+}
+
+size_t markcore_document_render_format_to_file(MCDocument_t *doc, MarkCoreFormat_e format, FILE *out_file) {
+	if (!doc || !out_file) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *r = create_format_renderer(doc, format, &sink);
+	if (!r) return 0;
+	
+	size_t bytes_written = render_syntax_tree(r, doc->root);
+	finish_document_render(doc, r);
+	
+	return bytes_written;
+}
+
+size_t markcore_document_render_with_passes(MCDocument_t *doc, MCPassPipeline_t *passes, FILE *out_file) {
+	if (!doc || !out_file) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *html_renderer = create_document_renderer(doc, &sink);
+	if (!html_renderer) return 0;
+	html_renderer->passes = passes;
+	
+	size_t bytes_written = render_syntax_tree(html_renderer, doc->root);
+	finish_document_render(doc, html_renderer);
+	
+	return bytes_written;
+}
+
+size_t markcore_document_render_template_to_file(MCDocument_t *doc, const MCHtmlTemplate_t *tmpl, FILE *out_file) {
+	if (!doc || !tmpl || !out_file) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *r = create_document_renderer(doc, &sink);
+	if (!r) return 0;
+	html_renderer_use_template(r, tmpl);
+	
+	size_t bytes_written = render_syntax_tree(r, doc->root);
+	finish_document_render(doc, r);
+	
+	return bytes_written;
+}
+
+void markcore_document_free(MCDocument_t *doc) {
+	if (!doc) return;
+	
+	// a document stays around while snapshots borrow its strings
+	if (atomic_fetch_sub_explicit(&doc->refcount, 1, memory_order_acq_rel) != 1) return;
+	
+	markcore_free_syntax_tree(doc->root);
+	if (doc->owns_strings) intern_table_destroy(doc->strings);
+	url_table_destroy(doc->urls);
+	heading_index_destroy(doc->headings);
+	block_index_destroy(doc->blocks);
+	if (!doc->origin) block_index_destroy(doc->lines);
+	mc_free(doc->compressed);
+	markcore_document_free(doc->origin);
+	mc_free(doc);
+}
+
+// Snapshots ===========================================
+
+MCDocument_t *markcore_document_snapshot(MCDocument_t *doc) {
+	if (!doc) return NULL;
+	
+	MCDocument_t *snapshot = document_create();
+	if (!snapshot) return NULL;
+	
+	MCDocument_t *origin = doc->origin ? doc->origin : doc;
+	atomic_fetch_add_explicit(&origin->refcount, 1, memory_order_relaxed);
+	snapshot->origin = origin;
+	snapshot->root = markcore_node_retain(doc->root);
+	
+	// line starts never change after the parse, the string cache does (escaped copies)
+	snapshot->lines = origin->lines;
+	snapshot->sourcepos_attributes = doc->sourcepos_attributes;
+	// the highlight cache is single threaded, snapshot renders call the highlighter directly
+	snapshot->highlighter = doc->highlighter;
+	snapshot->highlighter.cache = NULL;
+	snapshot->limits = doc->limits;
+	snapshot->status = doc->status;
+	return snapshot;
+}
+
+int markcore_document_replace_blocks(MCDocument_t *doc,
+									 size_t first_block,
+									 size_t last_block,
+									 const char *markdown,
+									 size_t length) {
+	if (!doc || doc->origin || !markdown) return 0;
+	
+	size_t block_count = markcore_document_block_count(doc);
+	if (first_block > last_block || last_block > block_count) return 0;
+	
+	// strings stay owned by the new nodes, the intern table may be in use by readers
+	MCParserContext_t context = {0};
+	context.limits = doc->limits;
+	context.urls = doc->urls;
+	MCNode_t *fragment = markcore_parse_with_context(&context, markdown, length);
+	if (!fragment) return 0;
+	
+	// one new root, every block around the edit is shared with the old tree
+	MCNode_t *root = markcore_tree_copy_path(doc->root, NULL, 0, NULL);
+	if (!root) {
+		markcore_free_syntax_tree(fragment);
+		return 0;
+	}
+	
+	for (int i = 0; i < fragment->child_count; i++) markcore_node_retain(fragment->children[i]);
+	if (!markcore_splice_children(root, (int)first_block, (int)(last_block - first_block),
+								  fragment->children, fragment->child_count)) {
+		for (int i = 0; i < fragment->child_count; i++) markcore_free_syntax_tree(fragment->children[i]);
+		markcore_free_syntax_tree(fragment);
+		markcore_free_syntax_tree(root);
+		return 0;
+	}
+	markcore_free_syntax_tree(fragment);
+	
+	markcore_free_syntax_tree(doc->root);
+	doc->root = root;
+	if (context.status != MARKCORE_OK && doc->status == MARKCORE_OK) doc->status = context.status;
+	
+	// source offsets no longer line up with the blocks, the old headings may be freed
+	block_index_destroy(doc->blocks);
+	doc->blocks = NULL;
+	if (doc->headings) index_headings(doc, 1);
+	mc_free(doc->compressed);
+	doc->compressed = NULL;
+	doc->compressed_size = 0;
+	
+	return 1;
+}
+
+// Passes ===========================================
+
+MCPassPipeline_t *markcore_pass_pipeline_create(void) {
+	return pass_pipeline_create();
+}
+
+void markcore_pass_pipeline_free(MCPassPipeline_t *pipeline) {
+	pass_pipeline_destroy(pipeline);
+}
+
+int markcore_pass_pipeline_register(MCPassPipeline_t *pipeline, const MarkCorePass_t *pass) {
+	return pass_pipeline_register(pipeline, pass);
+}
+
+void markcore_pass_pipeline_run(MCPassPipeline_t *pipeline, MCDocument_t *doc) {
+	if (!doc) return;
+	pass_pipeline_run(pipeline, doc->root);
+}
+
+MarkCoreNodeType_e markcore_node_type(const MCNode_t *node) {
+	return node ? (MarkCoreNodeType_e)node->type : MARKCORE_NODE_TYPE_COUNT;
+}
+
+const char *markcore_node_content(const MCNode_t *node) {
+	return node ? node->content : NULL;
+}
+
+const char *markcore_node_data(const MCNode_t *node) {
+	return node ? node->data : NULL;
+}
+
+MCHtmlTemplate_t *markcore_html_template_create(void) {
+	return html_template_create();
+}
+
+int markcore_html_template_set(MCHtmlTemplate_t *tmpl, MarkCoreTemplateElement_e element, const char *open, const char *close) {
+	return html_template_set(tmpl, element, open, close);
+}
+
+void markcore_html_template_free(MCHtmlTemplate_t *tmpl) {
+	html_template_destroy(tmpl);
+}
+
+MCHighlightCache_t *markcore_highlight_cache_create(size_t max_bytes) {
+	return highlight_cache_create(max_bytes);
+}
+
+void markcore_highlight_cache_stats(MCHighlightCache_t *cache, size_t *hits, size_t *misses, size_t *bytes) {
+	if (hits) *hits = cache ? cache->hits : 0;
+	if (misses) *misses = cache ? cache->misses : 0;
+	if (bytes) *bytes = cache ? cache->bytes : 0;
+}
+
+void markcore_highlight_cache_free(MCHighlightCache_t *cache) {
+	highlight_cache_destroy(cache);
+}
+
+MCInternTable_t *markcore_strings_create(void) {
+	return intern_table_create();
+}
+
+void markcore_strings_free(MCInternTable_t *strings) {
+	intern_table_destroy(strings);
+}
+
+MarkCoreStatus_e markcore_document_status(MCDocument_t *doc) {
+	return doc ? doc->status : MARKCORE_OK;
+}
+
+// Footprint ===========================================
+
+size_t markcore_document_memory(MCDocument_t *doc, MarkCoreMemory_t *memory) {
+	MarkCoreMemory_t m = {0};
+	if (doc) {
+		MCTreeMemory_t tree;
+		markcore_tree_memory(doc->root, &tree);
+		m.nodes = tree.nodes;
+		m.children = tree.children;
+		m.strings = tree.strings;
+		
+		// snapshots borrow everything but the tree from their origin
+		if (!doc->origin) {
+			if (doc->owns_strings) m.string_table = intern_table_memory(doc->strings);
+			m.indexes = block_index_memory(doc->blocks) + block_index_memory(doc->lines) +
+						heading_index_memory(doc->headings) + url_table_memory(doc->urls);
+		}
+		m.cache = doc->compressed ? doc->compressed_size : 0;
+		m.total = sizeof(MCDocument_t) + m.nodes + m.children + m.strings + m.string_table + m.indexes + m.cache;
+	}
+	
+	if (memory) *memory = m;
+	return m.total;
+}
+
+size_t markcore_document_shrink(MCDocument_t *doc) {
+	if (!doc || doc->origin) return 0;
+	
+	size_t released = markcore_tree_shrink(doc->root) + block_index_shrink(doc->blocks);
+	
+	// snapshots read the line index in place
+	if (atomic_load_explicit(&doc->refcount, memory_order_acquire) == 1) released += block_index_shrink(doc->lines);
+	return released;
+}
+
+// Profiling ===========================================
+
+size_t markcore_node_type_count(void) {
+	return NODE_TYPE_COUNT;
+}
+
+const char *markcore_node_type_name(size_t type) {
+	return type < NODE_TYPE_COUNT ? type_labels[type] : NULL;
+}
+
+// explicit stack, emphasis can nest far deeper than containers
+size_t markcore_document_count_nodes(MCDocument_t *doc, size_t *counts) {
+	if (counts) memset(counts, 0, sizeof(size_t) * NODE_TYPE_COUNT);
+	if (!doc || !doc->root) return 0;
+	
+	Stack_t *pending = stack_create(16);
+	if (!pending) return 0;
+	stack_push(pending, doc->root);
+	
+	size_t total = 0;
+	MCNode_t *node;
+	while ((node = stack_pop(pending))) {
+		total++;
+		if (counts) counts[node->type]++;
+		for (int i = node->child_count - 1; i >= 0; i--) {
+			if (node->children[i]) stack_push(pending, node->children[i]);
+		}
+	}
+	
+	stack_free(pending);
+	return total;
+}
+
+int markcore_alloc_stats(MarkCoreAllocStats_t *stats) {
+	mc_alloc_stats(stats);
+#ifdef MARKCORE_INSTRUMENT
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void markcore_alloc_stats_reset(void) {
+	mc_alloc_stats_reset();
+}
+
+// Compression ===========================================
+
+static MCDeflateFormat_e deflate_format(MarkCoreCompression_e format) {
+	return format == MARKCORE_GZIP ? MC_DEFLATE_GZIP : MC_DEFLATE_ZLIB;
+}
+
+// returns the compressed size, 0 on failure
+static size_t render_compressed(MCDocument_t *doc, MarkCoreCompression_e format, int level, MCSink_t *out) {
+	MCSink_t deflate;
+	if (!sink_init_deflate(&deflate, out, deflate_format(format), level)) {
+		fprintf(stderr, "Failed to start compression\n");
+		return 0;
+	}
+	
+	Renderer_t *html_renderer = create_document_renderer(doc, &deflate);
+	if (!html_renderer) {
+		sink_release(&deflate);
+		return 0;
+	}
+	
+	(void)render_syntax_tree(html_renderer, doc->root);
+	finish_document_render(doc, html_renderer);
+	
+	int ok = sink_finish(&deflate) && !out->failed;
+	sink_release(&deflate);
+	return ok ? out->bytes_written : 0;
+}
+
+const void *markcore_document_compressed(MCDocument_t *doc, MarkCoreCompression_e format, int level, size_t *size) {
+	if (!doc || !size || !doc->cache_compressed) return NULL;
+	
+	if (doc->compressed && doc->compressed_format == format && doc->compressed_level == level) {
+		*size = doc->compressed_size;
+		return doc->compressed;
+	}
+	
+	MCSink_t memory;
+	sink_init_memory(&memory);
+	if (!render_compressed(doc, format, level, &memory)) {
+		sink_release(&memory);
+		return NULL;
+	}
+	
+	// the memory sink's buffer becomes the cache
+	mc_free(doc->compressed);
+	doc->compressed = memory.buffer;
+	doc->compressed_size = memory.length;
+	doc->compressed_format = format;
+	doc->compressed_level = level;
+	
+	*size = doc->compressed_size;
+	return doc->compressed;
+}
+
+size_t markcore_document_render_compressed_to_file(MCDocument_t *doc, MarkCoreCompression_e format, int level, FILE *out_file) {
+	if (!doc || !out_file) return 0;
+	
+	if (doc->cache_compressed) {
+		size_t size;
+		const void *compressed = markcore_document_compressed(doc, format, level, &size);
+		return compressed ? fwrite(compressed, 1, size, out_file) : 0;
+	}
+	
+	MCSink_t file_sink;
+	sink_init_file(&file_sink, out_file);
+	return render_compressed(doc, format, level, &file_sink);
+}
+
+// Streaming ===========================================
+
+struct MCRenderStream {
+	MCDocument_t *doc;
+	Renderer_t *renderer;
+	MCRenderCursor_t cursor;
+	
+	// output of the current step, drained into the caller's buffers
+	MCSink_t pending;
+	size_t pending_offset;
+	int done;
+	
+	int compressed; // renderer writes through deflate into pending
+	MCSink_t deflate;
+};
+
+static MCRenderStream_t *create_render_stream(MCDocument_t *doc, int compressed, MCDeflateFormat_e format, int level) {
+	if (!doc) return NULL;
+	
+	MCRenderStream_t *stream = mc_calloc(1, sizeof(MCRenderStream_t));
+	if (!stream) return NULL;
+	
+	stream->doc = doc;
+	sink_init_memory(&stream->pending);
+	
+	if (compressed) {
+		if (!sink_init_deflate(&stream->deflate, &stream->pending, format, level)) {
+			fprintf(stderr, "Failed to start compression\n");
+			mc_free(stream);
+			return NULL;
+		}
+		stream->compressed = 1;
+	}
+	
+	stream->renderer = create_document_renderer(doc, compressed ? &stream->deflate : &stream->pending);
+	if (!stream->renderer || !render_cursor_begin(&stream->cursor, stream->renderer, doc->root)) {
+		markcore_render_stream_free(stream);
+		return NULL;
+	}
+	
+	return stream;
+}
+
+MCRenderStream_t *markcore_render_stream_create(MCDocument_t *doc) {
+	return create_render_stream(doc, 0, MC_DEFLATE_RAW, 0);
+}
+
+MCRenderStream_t *markcore_render_stream_create_compressed(MCDocument_t *doc, MarkCoreCompression_e format, int level) {
+	return create_render_stream(doc, 1, deflate_format(format), level);
+}
+
+size_t markcore_render_stream_read(MCRenderStream_t *stream, char *buffer, size_t size) {
+	if (!stream || !buffer) return 0;
+	
+	size_t copied = 0;
+	while (copied < size) {
+		size_t available = stream->pending.length - stream->pending_offset;
+		if (available > 0) {
+			size_t n = available < size - copied ? available : size - copied;
+			memcpy(buffer + copied, stream->pending.buffer + stream->pending_offset, n);
+			stream->pending_offset += n;
+			copied += n;
+			continue;
+		}
+		
+		stream->pending.length = 0;
+		stream->pending_offset = 0;
+		if (stream->done) break;
+		
+		// refill by rendering one more step
+		if (!render_cursor_step(&stream->cursor)) {
+			stream->done = 1;
+			if (stream->compressed) (void)sink_finish(&stream->deflate);
+			if (stream->renderer->truncated && stream->doc->status == MARKCORE_OK) {
+				stream->doc->status = MARKCORE_LIMIT_OUTPUT;
+			}
+		}
+	}
+	
+	return copied;
+}
+
+int markcore_render_stream_done(MCRenderStream_t *stream) {
+	return !stream || (stream->done && stream->pending_offset == stream->pending.length);
+}
+
+void markcore_render_stream_free(MCRenderStream_t *stream) {
+	if (!stream) return;
+	render_cursor_end(&stream->cursor);
+	renderer_destroy(stream->renderer);
+	if (stream->compressed) sink_release(&stream->deflate);
+	sink_release(&stream->pending);
+	mc_free(stream);
+}
+
+// Headings ===========================================
+
+size_t markcore_document_heading_count(MCDocument_t *doc) {
+	if (!doc || !doc->headings) return 0;
+	return doc->headings->count;
+}
+
+int markcore_document_heading(MCDocument_t *doc, size_t index, int *level, const char **text, size_t *text_len, const char **anchor) {
+	if (index >= markcore_document_heading_count(doc)) return 0;
+	
+	MCHeading_t *heading = &doc->headings->items[index];
+	if (level) *level = heading->level;
+	if (text) *text = heading->text;
+	if (text_len) *text_len = heading->text_len;
+	if (anchor) *anchor = heading->anchor;
+	return 1;
+}
+
+size_t markcore_document_render_toc_to_file(MCDocument_t *doc, FILE *out_file) {
+	if (!doc || !doc->headings || !out_file) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *html_renderer = create_document_renderer(doc, &sink);
+	if (!html_renderer) return 0;
+	
+	size_t bytes_written = render_heading_toc(html_renderer, doc->headings);
+	finish_document_render(doc, html_renderer);
+	
+	return bytes_written;
+}
+
+// Sections ===========================================
+
+size_t markcore_document_block_count(MCDocument_t *doc) {
+	return doc ? (size_t)doc->root->child_count : 0;
+}
+
+size_t markcore_document_block_at_offset(MCDocument_t *doc, size_t offset) {
+	if (!doc || !doc->blocks) return markcore_document_block_count(doc);
+	return block_index_find(doc->blocks, offset);
+}
+
+int markcore_document_line_column(MCDocument_t *doc, size_t offset, size_t *line, size_t *column) {
+	if (!doc || !doc->lines || !line || !column) return 0;
+	block_index_line_column(doc->lines, offset, line, column);
+	return 1;
+}
+
+size_t markcore_document_render_blocks_to_file(MCDocument_t *doc, size_t first_block, size_t last_block, FILE *out_file) {
+	if (!doc || !out_file) return 0;
+	
+	size_t block_count = markcore_document_block_count(doc);
+	if (last_block > block_count) last_block = block_count;
+	if (first_block >= last_block) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *html_renderer = create_document_renderer(doc, &sink);
+	if (!html_renderer) return 0;
+	
+	size_t bytes_written = 0;
+	for (size_t i = first_block; i < last_block; i++) {
+		bytes_written += render_syntax_tree(html_renderer, doc->root->children[i]);
+	}
+	finish_document_render(doc, html_renderer);
+	
+	return bytes_written;
+}
+
+size_t markcore_document_render_section_to_file(MCDocument_t *doc, size_t heading, FILE *out_file) {
+	if (heading >= markcore_document_heading_count(doc)) return 0;
+	
+	MCHeading_t *h = &doc->headings->items[heading];
+	return markcore_document_render_blocks_to_file(doc, h->block, h->section_end, out_file);
+}
+
+size_t markcore_document_render_headings_to_file(MCDocument_t *doc, size_t first_heading, size_t last_heading, FILE *out_file) {
+	size_t heading_count = markcore_document_heading_count(doc);
+	if (first_heading >= heading_count || first_heading >= last_heading) return 0;
+	
+	size_t first_block = doc->headings->items[first_heading].block;
+	size_t last_block = (last_heading < heading_count) ? doc->headings->items[last_heading].block : markcore_document_block_count(doc);
+	return markcore_document_render_blocks_to_file(doc, first_block, last_block, out_file);
+}
+
+// Search ===========================================
+
+size_t markcore_document_extract_tokens(MCDocument_t *doc, MarkCoreToken_f callback, void *userdata) {
+	if (!doc) return 0;
+	return extract_tree_tokens(doc->root, doc->blocks, callback, userdata);
+}
+
+// Serialization ===========================================
+
+void *markcore_document_serialize(MCDocument_t *doc, size_t *out_size) {
+	if (!doc || !out_size) return NULL;
+	return markcore_serialize_tree(doc->root, out_size);
+}
+
+MCDocument_t *markcore_document_deserialize(const void *blob, size_t size) {
+	MCNode_t *root = markcore_deserialize_tree(blob, size);
+	if (!root) return NULL;
+	
+	MCDocument_t *doc = document_create();
+	if (!doc) {
+		markcore_free_syntax_tree(root);
+		return NULL;
+	}
+	
+	doc->root = root;
+	
+	// blobs carry the anchors, so the index can be rebuilt without reslugging
+	index_headings(doc, 0);
+	if (doc->headings && doc->headings->count == 0) {
+		heading_index_destroy(doc->headings);
+		doc->headings = NULL;
+	}
+	
+	return doc;
+}
+
+size_t markcore_render_serialized_to_file(const void *blob, size_t size, FILE *out_file) {
+	if (!blob || !out_file) return 0;
+	
+	MCSink_t sink;
+	sink_init_file(&sink, out_file);
+	
+	Renderer_t *html_renderer = create_html_renderer(&sink);
+	if (!html_renderer) {
+		fprintf(stderr, "Failed to make HTML renderer\n");
+		return 0;
+	}
+	
+	size_t bytes_written = render_serialized_tree(html_renderer, blob, size);
+	renderer_destroy(html_renderer);
+	
+	return bytes_written;
+}
+
 // size_t markcore_render_to_buffer(const char *markdown,
 // 								 char *write_buffer,
 // 								 size_t buffer_size);
@@ -1,57 +1,255 @@
 
 #include "parser.h"
+#include "alloc.h"
 #include "stack.h"
+#include "block_start.h"
 
 #include <string.h>
 #include <stdio.h>
-#include <ctype.h>
+#include <time.h>
 
 #define LINE_BUFFER_SIZE 1024
 #define INITIAL_CHILD_CAPACITY 1
-
-static Stack_t *node_stack;
+#define PARSER_TIME_CHECK_LINES 64
 
 // Forward declaration ======================================================
 
-static void markcore_parse_line(char *markdown, size_t len);
+static void markcore_parse_line(MCParserContext_t *ctx, char *markdown, size_t len);
 
-static MCNode_t *markcore_parse_image(char *p);
+static MCNode_t *markcore_parse_image(MCParserContext_t *ctx, char *p);
 
-static void markcore_parse_inline_range(char *start, char *end);
+static void markcore_parse_inline_range(MCParserContext_t *ctx, char *start, char *end);
+static void parse_inline_block(MCParserContext_t *ctx, char *start, char *end, size_t line);
 
-static MCNode_t *markcore_parse_link(char **p_ptr);
-static MCNode_t *markcore_parse_italics_bold(char **p_ptr);
+static MCNode_t *markcore_parse_link(MCParserContext_t *ctx, char **p_ptr);
+static MCNode_t *markcore_parse_italics_bold(MCParserContext_t *ctx, char **p_ptr);
 
-static void flush_text(char *start, char *end);
+static void flush_text(MCParserContext_t *ctx, char *start, char *end);
+static void flush_code_block(MCParserContext_t *ctx, MCNode_t *code_block);
+static void close_paragraph(MCParserContext_t *ctx);
+static int is_code_fence(const char *p, size_t len);
 
 static void debug_print_range(const char *start, const char *end, const char *label);
 
 // Tree functions
 
-static MCNode_t *create_node(MCNodeType_e type, const char *content) {
-	MCNode_t *node = malloc(sizeof(MCNode_t));
+MCNode_t *markcore_create_node(MCNodeType_e type, const char *content) {
+	MCNode_t *node = mc_malloc(sizeof(MCNode_t));
     if (!node) return NULL;
     node->type = type;
-    node->content = content ? strdup(content) : NULL;
+    node->content = content ? mc_strdup(content) : NULL;
     node->children = NULL;
     node->child_count = 0;
     node->child_capacity = 0;
 	node->data = NULL;
+	node->flags = 0;
+	node->content_id = MC_NO_STRING_ID;
+	node->data_id = MC_NO_STRING_ID;
+	node->source_start = 0;
+	node->source_end = 0;
+	atomic_init(&node->refcount, 1);
     return node;
 }
 
-static void add_child_node(MCNode_t *parent, MCNode_t *child) {
+MCNode_t *markcore_node_retain(MCNode_t *node) {
+	if (node) atomic_fetch_add_explicit(&node->refcount, 1, memory_order_relaxed);
+	return node;
+}
+
+int markcore_node_is_shared(const MCNode_t *node) {
+	return atomic_load_explicit(&node->refcount, memory_order_acquire) > 1;
+}
+
+// strings the node owns are copied, borrowed ones stay borrowed from the same table
+static char *copy_node_string(const char *s, int borrowed) {
+	if (!s || borrowed) return (char *)s;
+	return mc_strdup(s);
+}
+
+MCNode_t *markcore_node_copy(const MCNode_t *node) {
+	if (!node) return NULL;
+	
+	MCNode_t *copy = mc_malloc(sizeof(MCNode_t));
+	if (!copy) return NULL;
+	
+	copy->type = node->type;
+	copy->flags = node->flags;
+	copy->header_level = node->header_level;
+	copy->content_id = node->content_id;
+	copy->data_id = node->data_id;
+	copy->source_start = node->source_start;
+	copy->source_end = node->source_end;
+	copy->content = copy_node_string(node->content, node->flags & MC_NODE_BORROWED_CONTENT);
+	copy->data = copy_node_string(node->data, node->flags & MC_NODE_BORROWED_DATA);
+	copy->children = NULL;
+	copy->child_count = 0;
+	copy->child_capacity = 0;
+	atomic_init(&copy->refcount, 1);
+	
+	if (node->child_count > 0) {
+		copy->children = mc_malloc(sizeof(MCNode_t *) * node->child_count);
+		if (!copy->children) {
+			markcore_free_syntax_tree(copy);
+			return NULL;
+		}
+		for (int i = 0; i < node->child_count; i++) {
+			copy->children[i] = markcore_node_retain(node->children[i]);
+		}
+		copy->child_count = node->child_count;
+		copy->child_capacity = node->child_count;
+	}
+	return copy;
+}
+
+MCNode_t *markcore_tree_copy_path(MCNode_t *root, const int *path, size_t depth, MCNode_t **leaf) {
+	MCNode_t *new_root = markcore_node_copy(root);
+	if (!new_root) return NULL;
+	
+	MCNode_t *node = new_root;
+	for (size_t i = 0; i < depth; i++) {
+		if (path[i] < 0 || path[i] >= node->child_count) {
+			markcore_free_syntax_tree(new_root);
+			return NULL;
+		}
+		
+		MCNode_t *child = node->children[path[i]];
+		MCNode_t *child_copy = markcore_node_copy(child);
+		if (!child_copy) {
+			markcore_free_syntax_tree(new_root);
+			return NULL;
+		}
+		node->children[path[i]] = child_copy;
+		markcore_free_syntax_tree(child); // the copy's reference, the old tree still holds it
+		node = child_copy;
+	}
+	
+	if (leaf) *leaf = node;
+	return new_root;
+}
+
+int markcore_splice_children(MCNode_t *parent, int index, int remove_count, MCNode_t **insert, int insert_count) {
+	if (!parent || index < 0 || remove_count < 0 || index + remove_count > parent->child_count) return 0;
+	if (markcore_node_is_shared(parent)) {
+		fprintf(stderr, "Can't change a shared node, copy it first\n");
+		return 0;
+	}
+	
+	int new_count = parent->child_count - remove_count + insert_count;
+	if (new_count > parent->child_capacity) {
+		MCNode_t **new_children = mc_realloc(parent->children, sizeof(MCNode_t *) * new_count);
+		if (!new_children) return 0;
+		parent->children = new_children;
+		parent->child_capacity = new_count;
+	}
+	
+	for (int i = index; i < index + remove_count; i++) {
+		markcore_free_syntax_tree(parent->children[i]);
+	}
+	memmove(parent->children + index + insert_count,
+			parent->children + index + remove_count,
+			sizeof(MCNode_t *) * (parent->child_count - index - remove_count));
+	if (insert_count > 0) memcpy(parent->children + index, insert, sizeof(MCNode_t *) * insert_count);
+	parent->child_count = new_count;
+	return 1;
+}
+
+// Footprint ========================================================
+
+// owned strings are always an exact strlen + 1 copy
+static size_t node_string_bytes(const char *s, int borrowed) {
+	return s && !borrowed ? strlen(s) + 1 : 0;
+}
+
+void markcore_tree_memory(MCNode_t *root, MCTreeMemory_t *memory) {
+	memset(memory, 0, sizeof(MCTreeMemory_t));
+	if (!root) return;
+	
+	// explicit stack, emphasis nests far deeper than containers
+	Stack_t *pending = stack_create(16);
+	stack_push(pending, root);
+	
+	MCNode_t *node;
+	while ((node = stack_pop(pending))) {
+		memory->nodes += sizeof(MCNode_t);
+		memory->children += sizeof(MCNode_t *) * node->child_capacity;
+		memory->strings += node_string_bytes(node->content, node->flags & MC_NODE_BORROWED_CONTENT);
+		memory->strings += node_string_bytes(node->data, node->flags & MC_NODE_BORROWED_DATA);
+		for (int i = 0; i < node->child_count; i++) {
+			if (node->children[i]) stack_push(pending, node->children[i]);
+		}
+	}
+	
+	stack_free(pending);
+}
+
+size_t markcore_tree_shrink(MCNode_t *root) {
+	if (!root) return 0;
+	
+	Stack_t *pending = stack_create(16);
+	stack_push(pending, root);
+	
+	size_t released = 0;
+	MCNode_t *node;
+	while ((node = stack_pop(pending))) {
+		// a shared node's subtree is shared too
+		if (markcore_node_is_shared(node)) continue;
+		
+		if (node->child_capacity > node->child_count) {
+			size_t unused = sizeof(MCNode_t *) * (node->child_capacity - node->child_count);
+			if (node->child_count == 0) {
+				mc_free(node->children);
+				node->children = NULL;
+				node->child_capacity = 0;
+				released += unused;
+			} else {
+				MCNode_t **children = mc_realloc(node->children, sizeof(MCNode_t *) * node->child_count);
+				if (children) {
+					node->children = children;
+					node->child_capacity = node->child_count;
+					released += unused;
+				}
+			}
+		}
+		
+		for (int i = 0; i < node->child_count; i++) {
+			if (node->children[i]) stack_push(pending, node->children[i]);
+		}
+	}
+	
+	stack_free(pending);
+	return released;
+}
+
+void markcore_node_set_content(MCNode_t *node, char *content) {
+	if (node->content && !(node->flags & MC_NODE_BORROWED_CONTENT)) mc_free(node->content);
+	node->content = content;
+	node->content_id = MC_NO_STRING_ID;
+	node->flags &= ~MC_NODE_BORROWED_CONTENT;
+}
+
+void markcore_node_set_data(MCNode_t *node, char *data) {
+	if (node->data && !(node->flags & MC_NODE_BORROWED_DATA)) mc_free(node->data);
+	node->data = data;
+	node->data_id = MC_NO_STRING_ID;
+	node->flags &= ~MC_NODE_BORROWED_DATA;
+}
+
+void markcore_add_child_node(MCNode_t *parent, MCNode_t *child) {
 	if (!parent || !child) return;
+	if (markcore_node_is_shared(parent)) {
+		fprintf(stderr, "Can't add to a shared node, copy it first\n");
+		return;
+	}
 	
 	if (!parent->children) {
 		// initialize
-		parent->children = malloc(sizeof(MCNode_t *) * INITIAL_CHILD_CAPACITY);
+		parent->children = mc_malloc(sizeof(MCNode_t *) * INITIAL_CHILD_CAPACITY);
 		parent->child_capacity = INITIAL_CHILD_CAPACITY;
 	}
 	
 	if (parent->child_count + 1 > parent->child_capacity) {
 		size_t new_capacity = parent->child_capacity * 2;
-		MCNode_t **new_children = realloc(parent->children, sizeof(MCNode_t *) * new_capacity);
+		MCNode_t **new_children = mc_realloc(parent->children, sizeof(MCNode_t *) * new_capacity);
 		if (!new_children) {
 			fprintf(stderr, "Failed to realloc children\n");
 			return;
@@ -63,48 +261,247 @@ static void add_child_node(MCNode_t *parent, MCNode_t *child) {
 	parent->child_count++;
 }
 
+// Limits ========================================================
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_us(void) {
+	return now_ns() / 1000;
+}
+
+static void trip_limit(MCParserContext_t *ctx, MarkCoreStatus_e status) {
+	if (ctx->status == MARKCORE_OK) ctx->status = status;
+}
+
+// every node the parser makes is counted against max_nodes, NULL once it's spent
+static MCNode_t *parser_create_node(MCParserContext_t *ctx, MCNodeType_e type, const char *content) {
+	if (ctx->limits.max_nodes && ctx->node_count >= ctx->limits.max_nodes) {
+		trip_limit(ctx, MARKCORE_LIMIT_NODES);
+		return NULL;
+	}
+	ctx->node_count++;
+	return markcore_create_node(type, content);
+}
+
+// Node strings come straight from the line buffer: interned when the document has a
+// string table, an owned copy otherwise
+static char *parser_string(MCParserContext_t *ctx, const char *start, size_t len, uint32_t *id) {
+	*id = MC_NO_STRING_ID;
+	
+	if (ctx->strings) {
+		*id = intern_table_add(ctx->strings, start, len);
+		if (*id != MC_NO_STRING_ID) return (char *)intern_table_get(ctx->strings, *id);
+	}
+	
+	char *copy = mc_malloc(len + 1);
+	if (!copy) return NULL;
+	memcpy(copy, start, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+static void parser_set_content(MCParserContext_t *ctx, MCNode_t *node, const char *start, size_t len) {
+	node->content = parser_string(ctx, start, len, &node->content_id);
+	if (node->content_id != MC_NO_STRING_ID) node->flags |= MC_NODE_BORROWED_CONTENT;
+}
+
+static void parser_set_data(MCParserContext_t *ctx, MCNode_t *node, const char *start, size_t len) {
+	node->data = parser_string(ctx, start, len, &node->data_id);
+	if (node->data_id != MC_NO_STRING_ID) node->flags |= MC_NODE_BORROWED_DATA;
+}
+
+// Source positions ========================================================
+
+static size_t source_offset(MCParserContext_t *ctx, const char *p) {
+	if (ctx->para_buf && p >= ctx->para_buf && p <= ctx->para_buf + ctx->para_len) {
+		// last segment starting at or before p
+		size_t at = p - ctx->para_buf;
+		size_t lo = 0;
+		size_t hi = ctx->para_segment_count;
+		if (hi == 0) return 0;
+		while (hi - lo > 1) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (ctx->para_segments[mid].buffer_offset <= at) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		return ctx->para_segments[lo].source_offset + (at - ctx->para_segments[lo].buffer_offset);
+	}
+	if (ctx->line_buf && p >= ctx->line_buf && p <= ctx->line_buf + LINE_BUFFER_SIZE) {
+		return ctx->line_offset + (p - ctx->line_buf);
+	}
+	return p - ctx->source;
+}
+
+static uint32_t position_value(size_t offset) {
+	return offset > UINT32_MAX ? UINT32_MAX : (uint32_t)offset;
+}
+
+static void set_position(MCParserContext_t *ctx, MCNode_t *node, const char *start, const char *end) {
+	if (!ctx->positions || !node) return;
+	node->source_start = position_value(source_offset(ctx, start));
+	node->source_end = position_value(source_offset(ctx, end));
+	node->flags |= MC_NODE_HAS_POSITION;
+}
+
+// containers grow as lines are added to them
+static void extend_position(MCParserContext_t *ctx, MCNode_t *node, const char *end) {
+	if (!ctx->positions || !node || !(node->flags & MC_NODE_HAS_POSITION)) return;
+	node->source_end = position_value(source_offset(ctx, end));
+}
+
+static void add_paragraph_segment(MCParserContext_t *ctx, size_t buffer_offset, const char *start) {
+	if (ctx->para_segment_count == ctx->para_segment_capacity) {
+		size_t capacity = ctx->para_segment_capacity ? ctx->para_segment_capacity * 2 : 16;
+		MCSourceSegment_t *segments = mc_realloc(ctx->para_segments, sizeof(MCSourceSegment_t) * capacity);
+		if (!segments) return;
+		ctx->para_segments = segments;
+		ctx->para_segment_capacity = capacity;
+	}
+	ctx->para_segments[ctx->para_segment_count].buffer_offset = buffer_offset;
+	ctx->para_segments[ctx->para_segment_count].source_offset = source_offset(ctx, start);
+	ctx->para_segment_count++;
+}
+
+// characters any markup output has to escape, see MC_NODE_ESCAPE_FREE
+static int is_escapable(char c) {
+	return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+static int over_time_budget(MCParserContext_t *ctx, size_t line_number) {
+	if (!ctx->limits.max_parse_us || line_number % PARSER_TIME_CHECK_LINES != 0) return 0;
+	if (now_us() - ctx->start_us <= ctx->limits.max_parse_us) return 0;
+	trip_limit(ctx, MARKCORE_LIMIT_TIME);
+	return 1;
+}
+
 // Core Parser functions ========================================================
 
 MCNode_t *markcore_parse(const char *markdown, size_t len) {
+	MCParserContext_t context = {0};
+	return markcore_parse_with_context(&context, markdown, len);
+}
 
-	MCNode_t *root = create_node(ROOT_NODE, NULL);
+MCNode_t *markcore_parse_with_context(MCParserContext_t *ctx, const char *markdown, size_t len) {
+
+	ctx->status = MARKCORE_OK;
+	ctx->node_count = 1;
+	ctx->start_us = ctx->limits.max_parse_us ? now_us() : 0;
+	ctx->code_start = NULL;
+	ctx->code_end = NULL;
+	ctx->code_escapable = 0;
+	ctx->para_node = NULL;
+	ctx->para_len = 0;
+	ctx->para_segment_count = 0;
+	ctx->table_node = NULL;
+	ctx->source = markdown;
+	
+	if (ctx->limits.max_input_bytes && len > ctx->limits.max_input_bytes) {
+		// keep whole lines where possible
+		size_t cut = ctx->limits.max_input_bytes;
+		while (cut > 0 && markdown[cut - 1] != '\n') cut--;
+		len = cut ? cut : ctx->limits.max_input_bytes;
+		trip_limit(ctx, MARKCORE_LIMIT_INPUT_SIZE);
+	}
+
+	MCNode_t *root = markcore_create_node(ROOT_NODE, NULL);
 
 	const char *p = markdown;
 	char line[LINE_BUFFER_SIZE];
 	
-// 	MCParserContext_t context = {};
-// 	context.stack = stack_create(4);
-	if (node_stack) stack_free(node_stack);
-	node_stack = stack_create(4);
-	stack_push(node_stack, root);
+	ctx->node_stack = stack_create(4);
+	stack_push(ctx->node_stack, root);
 
-	while (*p && ((size_t)(p - markdown) < len)) {
+	const char *end = markdown + len;
+	size_t line_number = 0;
+
+	while (p < end && *p) {
+		// node/time limits stop the parse between lines so the tree stays well formed
+		if (ctx->status == MARKCORE_LIMIT_NODES || over_time_budget(ctx, line_number)) break;
+		line_number++;
+		ctx->line_number = line_number;
+		
+		if (ctx->lines && (p == markdown || p[-1] == '\n')) block_index_append(ctx->lines, p - markdown);
+		
+		// stop scanning at the buffer size, long lines are split into chunks
 		size_t line_len = 0;
-		while ((size_t)(p + line_len - markdown) < len && p[line_len] && p[line_len] != '\n')
+		size_t max_len = (size_t)(end - p) < LINE_BUFFER_SIZE - 1 ? (size_t)(end - p) : LINE_BUFFER_SIZE - 1;
+		while (line_len < max_len && p[line_len] && p[line_len] != '\n')
             line_len++;
-        if (line_len >= LINE_BUFFER_SIZE) {
-        	line_len = LINE_BUFFER_SIZE - 1;
-        	fprintf(stderr, "Line is too long: %s\n", p);
+        
+		MCNode_t *top_node = stack_peek(ctx->node_stack);
+		if (top_node->type == CODE_BLOCK_NODE && ctx->node_stack->size == 2 && !is_code_fence(p, line_len)) {
+			// top level code lines aren't parsed, just added to the block's span
+			if (!ctx->code_start) ctx->code_start = p;
+			for (size_t i = 0; i < line_len; i++) {
+				if (is_escapable(p[i])) {
+					ctx->code_escapable = 1;
+					break;
+				}
+			}
+			p += line_len;
+			if (p < end && *p == '\n') p++;
+			ctx->code_end = p;
+			continue;
+		}
+		
+        if (line_len == LINE_BUFFER_SIZE - 1 && p + line_len < end && p[line_len] && p[line_len] != '\n') {
+        	fprintf(stderr, "Line is too long, splitting at %d bytes\n", LINE_BUFFER_SIZE - 1);
 		}
-		strncpy(line, p, line_len);
+		memcpy(line, p, line_len);
 		line[line_len] = '\0';
+		ctx->line_buf = line;
+		ctx->line_offset = p - markdown;
+		ctx->line_newline = p + line_len < end && p[line_len] == '\n';
 		
-		markcore_parse_line(line, line_len);
+		int block_count = root->child_count;
+		markcore_parse_line(ctx, line, line_len);
+		if (ctx->blocks) {
+			for (int b = block_count; b < root->child_count; b++) {
+				block_index_append(ctx->blocks, p - markdown);
+			}
+		}
 
 		p += line_len;
 		
-		if (*p == '\n') p++;
+		if (p < end && *p == '\n') p++;
 	}
 	
-	stack_free(node_stack);
+	// unclosed code block runs to the end of the input
+	MCNode_t *top_node = stack_peek(ctx->node_stack);
+	if (top_node && top_node->type == CODE_BLOCK_NODE) flush_code_block(ctx, top_node);
+	close_paragraph(ctx);
+	ctx->table_node = NULL;
+	
+	stack_free(ctx->node_stack);
+	ctx->node_stack = NULL;
+	mc_free(ctx->para_buf);
+	ctx->para_buf = NULL;
+	ctx->para_capacity = 0;
+	mc_free(ctx->para_segments);
+	ctx->para_segments = NULL;
+	ctx->para_segment_capacity = 0;
+	ctx->line_buf = NULL;
+	
+	set_position(ctx, root, markdown, markdown + len);
+	
+	if (ctx->urls) url_table_flush(ctx->urls);
+	if (ctx->headings) heading_index_finish(ctx->headings, root->child_count);
 
 	return root;
 }
 
 // Helper ======================================================
 
+// inline constructs don't span lines, so seeks stop at the end of the line
 static char *seek_next_char(char *p, const char c) {
-	while (*p != '\0') {
+	while (*p != '\0' && *p != '\n') {
 		if (*p == c) {
 			return p;
 		}
@@ -113,41 +510,139 @@ static char *seek_next_char(char *p, const char c) {
 	return NULL;
 }
 
-static size_t is_ordered_list_item(char **p_ptr) {
+// First paragraph line in (start, end) whose source doesn't follow on from the line before,
+// where a container prefix ("> ", an item's indent) was taken off. NULL if there is none
+static char *next_source_gap(MCParserContext_t *ctx, char *start, char *end) {
+	if (!ctx->positions || !ctx->para_buf || start < ctx->para_buf || start > ctx->para_buf + ctx->para_len) return NULL;
 	
-	char *p = *p_ptr;
+	size_t at = start - ctx->para_buf;
+	size_t until = end - ctx->para_buf;
+	size_t lo = 0;
+	size_t hi = ctx->para_segment_count;
+	while (lo < hi) { // first segment past start
+		size_t mid = lo + (hi - lo) / 2;
+		if (ctx->para_segments[mid].buffer_offset <= at) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
 	
-    if (*p == '\0' || !isdigit((unsigned char)*p)) return 0;
-    while (*p != '\0' && isdigit((unsigned char)*p)) p++;
+	for (size_t i = lo ? lo : 1; i < ctx->para_segment_count && ctx->para_segments[i].buffer_offset < until; i++) {
+		MCSourceSegment_t *prev = &ctx->para_segments[i - 1];
+		MCSourceSegment_t *segment = &ctx->para_segments[i];
+		if (prev->source_offset + (segment->buffer_offset - prev->buffer_offset) != segment->source_offset) {
+			return ctx->para_buf + segment->buffer_offset;
+		}
+	}
+	return NULL;
+}
 
-    if (*p == '\0' || (*p != '.' && *p != ')')) return 0;
-    p++; // skip . or )
+// add text node to parent (call this right before adding a bold child node for example)
+static void flush_text(MCParserContext_t *ctx, char *start, char *end) {
+	if (start == end || start > end) return;
+	
+	// with positions a text node has to match its source range byte for byte
+	char *gap;
+	while ((gap = next_source_gap(ctx, start, end))) {
+		flush_text(ctx, start, gap);
+		start = gap;
+	}
+	
+	MCNode_t *top_node = stack_peek(ctx->node_stack);
+	MCNode_t *text_node = parser_create_node(ctx, TEXT_NODE, NULL);
+	if (!text_node) return;
+	
+	parser_set_content(ctx, text_node, start, end - start);
+	set_position(ctx, text_node, start, end);
+	markcore_add_child_node(top_node, text_node);
+}
 
-    if (*p == '\0' || *p != ' ') return 0;
-    
-    *p_ptr = p; // set read head after list entry point
+// whole code block as a single text node, newlines included
+static void flush_code_block(MCParserContext_t *ctx, MCNode_t *code_block) {
+	if (!ctx->code_start) return;
+	
+	MCNode_t *text_node = parser_create_node(ctx, TEXT_NODE, NULL);
+	if (text_node) {
+		parser_set_content(ctx, text_node, ctx->code_start, ctx->code_end - ctx->code_start);
+		if (!ctx->code_escapable) text_node->flags |= MC_NODE_ESCAPE_FREE;
+		set_position(ctx, text_node, ctx->code_start, ctx->code_end);
+		markcore_add_child_node(code_block, text_node);
+	}
+	extend_position(ctx, code_block, ctx->code_end);
+	
+	ctx->code_start = NULL;
+	ctx->code_end = NULL;
+	ctx->code_escapable = 0;
+}
 
-    return 1;
+// Paragraphs ==========================================================
+
+static int append_paragraph_line(MCParserContext_t *ctx, const char *start, size_t len) {
+	size_t needed = ctx->para_len + len + 2; // '\n' separator and NUL
+	if (needed > ctx->para_capacity) {
+		size_t new_capacity = ctx->para_capacity ? ctx->para_capacity * 2 : LINE_BUFFER_SIZE;
+		while (new_capacity < needed) new_capacity *= 2;
+		char *new_buf = mc_realloc(ctx->para_buf, new_capacity);
+		if (!new_buf) return 0;
+		ctx->para_buf = new_buf;
+		ctx->para_capacity = new_capacity;
+	}
+	
+	if (ctx->para_len > 0) ctx->para_buf[ctx->para_len++] = '\n';
+	if (ctx->positions) add_paragraph_segment(ctx, ctx->para_len, start);
+	memcpy(ctx->para_buf + ctx->para_len, start, len);
+	ctx->para_len += len;
+	ctx->para_buf[ctx->para_len] = '\0';
+	return 1;
 }
 
-// add text node to parent (call this right before adding a bold child node for example)
-static void flush_text(char *start, char *end) {
-	if (start == end || start > end) return;
-	size_t len = end - start;
-	char *text_buffer = malloc(len + 1);
-	strncpy(text_buffer, start, len);
-	text_buffer[len] = '\0';
+// Consecutive text lines become one LINE_NODE. The node goes into the tree with the first
+// line (so block order and offsets are right), its children once the paragraph ends, so text
+// runs continue across line breaks as single nodes. Continuation lines keep their indent
+// so the paragraph text matches the source byte for byte
+static void add_paragraph_line(MCParserContext_t *ctx, MCNode_t *parent, char *line, char *start, char *end) {
+	int continues = ctx->para_node && parent->child_count > 0 && parent->children[parent->child_count - 1] == ctx->para_node;
+	if (continues) {
+		start = line;
+		extend_position(ctx, ctx->para_node, end);
+	} else {
+		close_paragraph(ctx);
+		
+		MCNode_t *line_node = parser_create_node(ctx, LINE_NODE, NULL);
+		if (!line_node) return;
+		set_position(ctx, line_node, start, end);
+		markcore_add_child_node(parent, line_node);
+		ctx->para_node = line_node;
+		ctx->para_line = ctx->line_number;
+	}
+	
+	if (!append_paragraph_line(ctx, start, end - start)) {
+		fprintf(stderr, "Failed to grow paragraph buffer\n");
+	}
+}
+
+static void close_paragraph(MCParserContext_t *ctx) {
+	if (!ctx->para_node) return;
 	
-	MCNode_t *top_node = stack_peek(node_stack);
-	MCNode_t *text_node = create_node(TEXT_NODE, text_buffer);
-	add_child_node(top_node, text_node);
+	stack_push(ctx->node_stack, ctx->para_node);
+	parse_inline_block(ctx, ctx->para_buf, ctx->para_buf + ctx->para_len, ctx->para_line);
+	(void)stack_pop(ctx->node_stack);
 	
-	free(text_buffer); // (it's strduped in create_node)
+	ctx->para_node = NULL;
+	ctx->para_len = 0;
+	ctx->para_segment_count = 0;
+}
+
+static int is_code_fence(const char *p, size_t len) {
+	const char *end = p + len;
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	return end - p >= 3 && strncmp(p, "```", 3) == 0;
 }
 
 // Inline Methods ==============================================
 
-static MCNode_t *markcore_parse_link(char **p_ptr) {
+static MCNode_t *markcore_parse_link(MCParserContext_t *ctx, char **p_ptr) {
 
 	char *p = *p_ptr;
 	char *start = p;
@@ -162,57 +657,61 @@ static MCNode_t *markcore_parse_link(char **p_ptr) {
 	char *close_link = seek_next_char(p, ')');
 	if (!close_link) return NULL;
 
+	MCNode_t *link_node = parser_create_node(ctx, LINK_NODE, NULL);
+	if (!link_node) return NULL;
+	
 	p = start + 1; // set read head to start of text label
-	size_t text_len = close_bracket - p;
-	char *text = malloc(text_len + 1);
-	strncpy(text, p, text_len);
-	text[text_len] = '\0';
+	parser_set_content(ctx, link_node, p, close_bracket - p);
 		
 	p = close_bracket + 2; // set read head to start of url
-	size_t url_len = close_link - open_link - 1;
-    char *url = malloc(url_len + 1);
-    memcpy(url, p, url_len);
-    url[url_len] = '\0';
-    
-	MCNode_t *link_node = create_node(LINK_NODE, text);
-	link_node->data = url;
+	parser_set_data(ctx, link_node, p, close_link - open_link - 1);
+	if (ctx->urls) url_table_bind(ctx->urls, link_node);
+	set_position(ctx, link_node, start, close_link + 1);
 	
 	*p_ptr = close_link + 1; // set read head
 	
-	free(text);
-	
 	return link_node;
 }
 
-static MCNode_t *markcore_parse_inline_code(char **p_ptr) {
+static MCNode_t *markcore_parse_inline_code(MCParserContext_t *ctx, char **p_ptr) {
 
 	char *p = *p_ptr;
 	char *start = p;
 	
 	p++;
 	
-	char *close_tick = seek_next_char(p, '`');
-	if (!close_tick) return NULL;
+	// seek the closing tick, noting anything the renderer would have to escape
+	int escapable = 0;
+	char *close_tick = p;
+	while (*close_tick != '\0' && *close_tick != '\n' && *close_tick != '`') {
+		if (is_escapable(*close_tick)) escapable = 1;
+		close_tick++;
+	}
+	if (*close_tick != '`') return NULL;
 
+	MCNode_t *inline_code_node = parser_create_node(ctx, CODE_INLINE_NODE, NULL);
+	if (!inline_code_node) return NULL;
+	
 	p = start + 1; // set read head to start of text labe
-	size_t text_len = close_tick - p;
-	char *text = malloc(text_len + 1);
-	strncpy(text, p, text_len);
-	text[text_len] = '\0';
-    
-	MCNode_t *inline_code_node = create_node(CODE_INLINE_NODE, text);
+	parser_set_content(ctx, inline_code_node, p, close_tick - p);
+	if (!escapable) inline_code_node->flags |= MC_NODE_ESCAPE_FREE;
+	set_position(ctx, inline_code_node, start, close_tick + 1);
 	
 	*p_ptr = close_tick + 1; // set read head
 	
-	free(text);
-	
 	return inline_code_node;
 }
 
-static MCNode_t *markcore_parse_italics_bold(char **p_ptr) {
+static MCNode_t *markcore_parse_italics_bold(MCParserContext_t *ctx, char **p_ptr) {
 	
 	char *p = *p_ptr;
 	char *start = p;
+	
+	// past max_depth emphasis stays literal text
+	if (ctx->limits.max_depth && ctx->node_stack->size >= (size_t)ctx->limits.max_depth) {
+		trip_limit(ctx, MARKCORE_LIMIT_DEPTH);
+		return NULL;
+	}
 		
 	int delimiter_count = 0;
 	while (*p != '\0' && *p == '*' && delimiter_count < 3) { delimiter_count++; p++; };
@@ -239,29 +738,42 @@ static MCNode_t *markcore_parse_italics_bold(char **p_ptr) {
 				
 	MCNode_t *italics_bold_node;
 	switch (delimiter_count) {
-		case 1: italics_bold_node = create_node(ITALIC_NODE, NULL); break;
-		case 2: italics_bold_node = create_node(BOLD_NODE, NULL); break;
-		case 3: italics_bold_node = create_node(BOLD_ITALIC_NODE, NULL); break;
+		case 1: italics_bold_node = parser_create_node(ctx, ITALIC_NODE, NULL); break;
+		case 2: italics_bold_node = parser_create_node(ctx, BOLD_NODE, NULL); break;
+		case 3: italics_bold_node = parser_create_node(ctx, BOLD_ITALIC_NODE, NULL); break;
 	}
-	
+	if (!italics_bold_node) return NULL;
+	set_position(ctx, italics_bold_node, start, next_delimiter + delimiter_count);
 	
 	p = start + delimiter_count;
 
-	stack_push(node_stack, italics_bold_node);
-	markcore_parse_inline_range(p, next_delimiter);
-	(void)stack_pop(node_stack);
+	stack_push(ctx->node_stack, italics_bold_node);
+	markcore_parse_inline_range(ctx, p, next_delimiter);
+	(void)stack_pop(ctx->node_stack);
 	
 	*p_ptr = next_delimiter + delimiter_count;
 	
 	return italics_bold_node;
 }
 
+// Inline parse of a whole paragraph or cell, reported to inline_profile when profiling
+static void parse_inline_block(MCParserContext_t *ctx, char *start, char *end, size_t line) {
+	if (!ctx->inline_profile) {
+		markcore_parse_inline_range(ctx, start, end);
+		return;
+	}
+	
+	uint64_t started = now_ns();
+	markcore_parse_inline_range(ctx, start, end);
+	ctx->inline_profile(line, now_ns() - started, ctx->inline_profile_userdata);
+}
+
 // recursive tree builder for inline parsing, cature and handle bold, italics, links, etc.
-static void markcore_parse_inline_range(char *start, char *end) {	
+static void markcore_parse_inline_range(MCParserContext_t *ctx, char *start, char *end) {	
 	
 	char *p = start;
 	
-	MCNode_t *top_node = stack_peek(node_stack);
+	MCNode_t *top_node = stack_peek(ctx->node_stack);
 	MCNode_t *new_node;
 		
 	char *last_text = start;
@@ -270,27 +782,27 @@ static void markcore_parse_inline_range(char *start, char *end) {
 		og_p = p;
 		switch (*p) {
 		case '[': // links
-			new_node = markcore_parse_link(&p);
+			new_node = markcore_parse_link(ctx, &p);
 			if (new_node) { 
-				flush_text(last_text, og_p);
+				flush_text(ctx, last_text, og_p);
 				last_text = p;
-				add_child_node(top_node, new_node);
+				markcore_add_child_node(top_node, new_node);
 			}
  			break;
  		case '*':
- 			new_node = markcore_parse_italics_bold(&p);
+ 			new_node = markcore_parse_italics_bold(ctx, &p);
  			if (new_node) {
-				flush_text(last_text, og_p);
+				flush_text(ctx, last_text, og_p);
 				last_text = p;
- 				add_child_node(top_node, new_node);
+ 				markcore_add_child_node(top_node, new_node);
  			}
  			break;
  		case '`': // inline code
- 			new_node = markcore_parse_inline_code(&p);
+ 			new_node = markcore_parse_inline_code(ctx, &p);
  			if (new_node) {
-				flush_text(last_text, og_p);
+				flush_text(ctx, last_text, og_p);
 				last_text = p;
- 				add_child_node(top_node, new_node);
+ 				markcore_add_child_node(top_node, new_node);
  			}
 		default:
 			break;
@@ -298,13 +810,13 @@ static void markcore_parse_inline_range(char *start, char *end) {
 		p++;
 	}
 	if (last_text < end) {
-		flush_text(last_text, end); // flush remaining text
+		flush_text(ctx, last_text, end); // flush remaining text
 	}
 }
 
 // Full Lines ==========================================================
 
-static MCNode_t *markcore_parse_image(char *p) {
+static MCNode_t *markcore_parse_image(MCParserContext_t *ctx, char *p) {
 
 	char *start = p;
 	
@@ -321,162 +833,450 @@ static MCNode_t *markcore_parse_image(char *p) {
 	char *close_link = seek_next_char(p, ')');
 	if (!close_link) return NULL;
 
+	MCNode_t *link_node = parser_create_node(ctx, IMAGE_NODE, NULL);
+	if (!link_node) return NULL;
+	
 	p = start + 2; // set read head to start of text label
-	size_t text_len = close_bracket - p;
-	char *text = malloc(text_len + 1);
-	strncpy(text, p, text_len);
-	text[text_len] = '\0';
+	parser_set_content(ctx, link_node, p, close_bracket - p);
 		
 	p = close_bracket + 2; // set read head to start of url
-	size_t url_len = close_link - open_link - 1;
-    char *url = malloc(url_len + 1);
-    memcpy(url, p, url_len);
-    url[url_len] = '\0';
-    
-	MCNode_t *link_node = create_node(IMAGE_NODE, text);
-	link_node->data = url;
-	
-	free(text);
+	parser_set_data(ctx, link_node, p, close_link - open_link - 1);
+	if (ctx->urls) url_table_bind(ctx->urls, link_node);
+	set_position(ctx, link_node, start, close_link + 1);
 	
 	return link_node;
 }
 
-static MCNode_t *markcore_parse_header(char *p) {
+static MCNode_t *markcore_parse_header(MCParserContext_t *ctx, char *p) {
+	char *start = p;
+	
 	// heading, count number
 	int header_count = 0;
 	while (*p != '\0' && *p == '#') { header_count++; p++; };
 	
 	// convert root to header
-	char *content = strdup(p);
-	if (!content) {
+	MCNode_t *header_node = parser_create_node(ctx, HEADER_NODE, NULL);
+	if (!header_node) return NULL;
+	
+	parser_set_content(ctx, header_node, p, strlen(p));
+	if (!header_node->content) {
 		fprintf(stderr, "Failed to copy content: %s\n", p);
+	}
+	header_node->header_level = header_count;
+	set_position(ctx, header_node, start, p + strlen(p));
+	return header_node;
+}
+
+// Containers ==========================================================
+
+static int is_blank_line(const char *p) {
+	while (*p == ' ' || *p == '\t') p++;
+	return *p == '\0' || *p == '\n';
+}
+
+// columns of blanks from p to end, tabs stop every 4 columns
+static int blank_columns(const char *p, const char *end) {
+	int columns = 0;
+	for (; p < end; p++) columns += *p == '\t' ? 4 - (columns % 4) : 1;
+	return columns;
+}
+
+static char *skip_columns(char *p, int columns) {
+	int skipped = 0;
+	while (skipped < columns && (*p == ' ' || *p == '\t')) {
+		skipped += *p == '\t' ? 4 - (skipped % 4) : 1;
+		p++;
+	}
+	return p;
+}
+
+static int is_list(const MCNode_t *node) {
+	return node->type == UNORDERED_LIST_NODE || node->type == ORDERED_LIST_NODE;
+}
+
+// consume the container's prefix from the line, 0 if the line doesn't continue it
+static int continue_container(MCNode_t *container, char **p_ptr) {
+	char *p = *p_ptr;
+	
+	switch (container->type) {
+		case BLOCKQUOTE_NODE: {
+			char *q = p;
+			while (q - p < 3 && *q == ' ') q++;
+			if (*q != '>') return 0;
+			q++;
+			if (*q == ' ' || *q == '\t') q++;
+			*p_ptr = q;
+			return 1;
+		}
+		case LIST_ITEM_NODE: {
+			// blank lines don't end items, content has to be indented past the marker
+			if (is_blank_line(p)) return 1;
+			char *q = p;
+			while (*q == ' ' || *q == '\t') q++;
+			if (blank_columns(p, q) < container->item_indent) return 0;
+			*p_ptr = skip_columns(p, container->item_indent);
+			return 1;
+		}
+		default:
+			return 1; // lists last as long as their items, see markcore_parse_line
+	}
+}
+
+// pop open containers down to keep entries, flushing a code block on the way
+static void close_containers(MCParserContext_t *ctx, size_t keep) {
+	while (ctx->node_stack->size > keep) {
+		MCNode_t *node = stack_pop(ctx->node_stack);
+		if (node->type == CODE_BLOCK_NODE) flush_code_block(ctx, node);
+		ctx->table_node = NULL; // a table only continues in the container it started in
+	}
+}
+
+// a list only takes the line when one of its items does
+static void extend_containers(MCParserContext_t *ctx, size_t count, char *end) {
+	if (!ctx->positions) return;
+	for (size_t i = 1; i < count; i++) {
+		MCNode_t *container = ctx->node_stack->items[i];
+		if (is_list(container) && i + 1 == count) break;
+		extend_position(ctx, container, end);
+	}
+}
+
+static MCNode_t *open_container(MCParserContext_t *ctx, MCNodeType_e type, char *start, char *end) {
+	MCNode_t *node = parser_create_node(ctx, type, NULL);
+	if (!node) return NULL;
+	set_position(ctx, node, start, end);
+	markcore_add_child_node(stack_peek(ctx->node_stack), node);
+	stack_push(ctx->node_stack, node);
+	return node;
+}
+
+// a list item of another kind ends the list and starts a new one
+static MCNode_t *open_list_item(MCParserContext_t *ctx, MCBlockStart_t *block, char *line, char *end) {
+	MCNodeType_e list_type = block->type == MC_BLOCK_BULLET ? UNORDERED_LIST_NODE : ORDERED_LIST_NODE;
+	
+	MCNode_t *top_node = stack_peek(ctx->node_stack);
+	if (is_list(top_node) && top_node->type != list_type) {
+		close_containers(ctx, ctx->node_stack->size - 1);
+		top_node = stack_peek(ctx->node_stack);
+	}
+	if (top_node->type == list_type) {
+		extend_position(ctx, top_node, end);
+	} else if (!open_container(ctx, list_type, block->start, end)) {
 		return NULL;
 	}
 	
-	MCNode_t *header_node = create_node(HEADER_NODE, NULL);
+	MCNode_t *item = open_container(ctx, LIST_ITEM_NODE, block->start, end);
+	if (!item) return NULL;
 	
-	header_node->content = content;
-	header_node->header_level = header_count;
-	return header_node;
+	// content indent is the marker plus the blanks after it, just one when the item
+	// is empty or the content looks indented
+	char *marker_end = block->type == MC_BLOCK_BULLET ? block->start + 1 : block->content;
+	char *q = marker_end;
+	while (*q == ' ' || *q == '\t') q++;
+	int spacing = blank_columns(marker_end, q);
+	if (spacing == 0 || spacing > 4 || is_blank_line(q)) spacing = 1;
+	item->item_indent = blank_columns(line, block->start) + (int)(marker_end - block->start) + spacing;
+	return item;
+}
+
+// The language is the first word of the info string after the fence, kept in data
+static void set_code_language(MCParserContext_t *ctx, MCNode_t *code_block, char *fence, char *end) {
+	char *p = fence;
+	while (p < end && *p == '`') p++;
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	
+	char *word = p;
+	while (p < end && *p != ' ' && *p != '\t' && *p != '`') p++;
+	if (p > word) parser_set_data(ctx, code_block, word, p - word);
+}
+
+// Code blocks inside containers get one text node per line, prefixes taken off
+static void add_code_line(MCParserContext_t *ctx, MCNode_t *code_block, char *p, char *end) {
+	if (is_code_fence(p, end - p)) {
+		flush_code_block(ctx, code_block);
+		extend_position(ctx, code_block, end);
+		(void)stack_pop(ctx->node_stack);
+		return;
+	}
+	
+	MCNode_t *text_node = parser_create_node(ctx, TEXT_NODE, NULL);
+	if (!text_node) return;
+	
+	size_t len = end - p;
+	char saved = *end;
+	if (ctx->line_newline) *end = '\n'; // the line buffer has room for it, NUL is put back below
+	parser_set_content(ctx, text_node, p, len + (ctx->line_newline ? 1 : 0));
+	*end = saved;
+	
+	int escapable = 0;
+	for (char *c = p; c < end && !escapable; c++) escapable = is_escapable(*c);
+	if (!escapable) text_node->flags |= MC_NODE_ESCAPE_FREE;
+	
+	set_position(ctx, text_node, p, end + (ctx->line_newline ? 1 : 0));
+	extend_position(ctx, code_block, end);
+	markcore_add_child_node(code_block, text_node);
+}
+
+// Tables ==========================================================
+
+// cells without the surrounding blanks and optional outer pipes
+static void trim_table_row(char **start, char **end) {
+	char *s = *start;
+	char *e = *end;
+	while (s < e && (*s == ' ' || *s == '\t')) s++;
+	while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+	if (s < e && *s == '|') s++;
+	if (e > s && e[-1] == '|' && (e - 1 == s || e[-2] != '\\')) e--;
+	*start = s;
+	*end = e;
+}
+
+// escaped pipes don't split cells
+static char *table_cell_end(char *p, char *end) {
+	while (p < end && *p != '|') {
+		if (*p == '\\' && p + 1 < end) p++;
+		p++;
+	}
+	return p;
+}
+
+static void trim_table_cell(char **start, char **end) {
+	while (*start < *end && (**start == ' ' || **start == '\t')) (*start)++;
+	while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t')) (*end)--;
+}
+
+static int count_table_cells(char *p, char *end) {
+	trim_table_row(&p, &end);
+	int cells = 1;
+	while ((p = table_cell_end(p, end)) < end) {
+		cells++;
+		p++;
+	}
+	return cells;
 }
 
-static void escape_if_in_list(MCNode_t **top_node) {
-	if ((*top_node)->type == UNORDERED_LIST_NODE || (*top_node)->type == ORDERED_LIST_NODE) {
-		// skip multi line
-		(void)stack_pop(node_stack);
-		*top_node = stack_peek(node_stack);
+// "| :--- | ---: |", fills align, the cell count or 0 if it isn't a delimiter row
+static int parse_table_delimiter(char *p, char *end, uint8_t *align) {
+	if (!memchr(p, '|', end - p)) return 0;
+	trim_table_row(&p, &end);
+	
+	int cells = 0;
+	for (;;) {
+		char *cell_end = table_cell_end(p, end);
+		char *c = p;
+		char *e = cell_end;
+		trim_table_cell(&c, &e);
+		
+		int left = c < e && *c == ':';
+		int right = e > c + left && e[-1] == ':';
+		char *dash = c + left;
+		char *dash_end = e - right;
+		if (dash >= dash_end || cells == MC_TABLE_MAX_COLUMNS) return 0;
+		for (char *d = dash; d < dash_end; d++) {
+			if (*d != '-') return 0;
+		}
+		
+		align[cells++] = left && right ? MC_TABLE_ALIGN_CENTER : right ? MC_TABLE_ALIGN_RIGHT : left ? MC_TABLE_ALIGN_LEFT : MC_TABLE_ALIGN_NONE;
+		if (cell_end >= end) return cells;
+		p = cell_end + 1;
+	}
+}
+
+// cells past the header's are dropped, short rows stay short
+static void add_table_row(MCParserContext_t *ctx, MCNode_t *table, char *start, char *end, int header) {
+	MCNode_t *row = parser_create_node(ctx, TABLE_ROW_NODE, NULL);
+	if (!row) return;
+	row->table_info = header ? MC_TABLE_HEADER : 0;
+	set_position(ctx, row, start, end);
+	markcore_add_child_node(table, row);
+	extend_position(ctx, table, end);
+	
+	char *p = start;
+	trim_table_row(&p, &end);
+	for (int column = 0; column < ctx->table_columns; column++) {
+		char *cell_end = table_cell_end(p, end);
+		char *c = p;
+		char *e = cell_end;
+		trim_table_cell(&c, &e);
+		
+		MCNode_t *cell = parser_create_node(ctx, TABLE_CELL_NODE, NULL);
+		if (!cell) return;
+		cell->table_info = row->table_info | ctx->table_align[column];
+		set_position(ctx, cell, c, e);
+		markcore_add_child_node(row, cell);
+		
+		// inline seeks stop at NUL, so constructs can't run into the next cell
+		char saved = *e;
+		*e = '\0';
+		stack_push(ctx->node_stack, cell);
+		parse_inline_block(ctx, c, e, header ? ctx->para_line : ctx->line_number); // headers were the paragraph
+		(void)stack_pop(ctx->node_stack);
+		*e = saved;
+		
+		if (cell_end >= end) break;
+		p = cell_end + 1;
 	}
 }
 
-static void markcore_parse_line(char *start, size_t len) {
-	// construct tree for start line
-	char *p = start;	
-	while (*p == ' ' || *p == '\t') p++; // trim leading whitespace
-	if (*p == '\n' || *p == '\0') return; // skip empty lines
+// A delimiter row under a one line paragraph with as many cells turns it into a table
+static int start_table(MCParserContext_t *ctx, MCNode_t *parent, char *p, char *end) {
+	MCNode_t *para = ctx->para_node;
+	if (!para || parent->child_count == 0 || parent->children[parent->child_count - 1] != para) return 0;
+	if (memchr(ctx->para_buf, '\n', ctx->para_len)) return 0;
+	
+	uint8_t align[MC_TABLE_MAX_COLUMNS];
+	int columns = parse_table_delimiter(p, end, align);
+	if (!columns || columns != count_table_cells(ctx->para_buf, ctx->para_buf + ctx->para_len)) return 0;
 	
-	MCNode_t *top_node = stack_peek(node_stack);
-	if (!top_node) {
-		fprintf(stderr, "Error, stack is empty\n");
+	para->type = TABLE_NODE;
+	ctx->table_node = para;
+	ctx->table_columns = columns;
+	memcpy(ctx->table_align, align, columns);
+	
+	add_table_row(ctx, para, ctx->para_buf, ctx->para_buf + ctx->para_len, 1);
+	extend_position(ctx, para, end);
+	
+	ctx->para_node = NULL;
+	ctx->para_len = 0;
+	ctx->para_segment_count = 0;
+	return 1;
+}
+
+// Full lines ==========================================================
+
+/*
+One pass per line over the open containers (node_stack): each one the line continues
+takes its prefix off ("> ", an item's indent), then new containers open on what's left
+and the rest is a leaf block in the innermost one. Work per line is bounded by the
+container depth, which is bounded by the prefixes on the line, so parsing stays linear.
+*/
+static void markcore_parse_line(MCParserContext_t *ctx, char *start, size_t len) {
+	Stack_t *stack = ctx->node_stack;
+	char *end = start + len;
+	char *p = start;
+	
+	size_t matched = 1; // root
+	while (matched < stack->size) {
+		MCNode_t *container = stack->items[matched];
+		if (container->type == CODE_BLOCK_NODE || !continue_container(container, &p)) break;
+		matched++;
+	}
+	
+	MCNode_t *top_node = stack_peek(stack);
+	if (top_node->type == CODE_BLOCK_NODE && matched == stack->size - 1) {
+		extend_containers(ctx, matched, end);
+		add_code_line(ctx, top_node, p, end);
 		return;
 	}
 	
-	MCNode_t *temp_node; // for header / image creation
+	MCBlockStart_t block;
+	classify_block_start(p, &block);
+	
+	if (block.type == MC_BLOCK_BLANK) { // empty lines end paragraphs, tables and unmarked quotes
+		close_containers(ctx, matched);
+		close_paragraph(ctx);
+		ctx->table_node = NULL;
+		return;
+	}
 	
-	// Skip formatting if in code block
-	if (top_node->type == CODE_BLOCK_NODE && strncmp(p, "```", 3) != 0) {
-		flush_text(start, start + len);
+	// lazy continuation, paragraph text carries on the open paragraph whatever matched
+	if (matched < stack->size && block.type == MC_BLOCK_PARAGRAPH && ctx->para_node &&
+		top_node->child_count > 0 && top_node->children[top_node->child_count - 1] == ctx->para_node) {
+		extend_containers(ctx, stack->size, end);
+		add_paragraph_line(ctx, top_node, p, block.start, end);
 		return;
 	}
 	
-	switch (*p) {
-		case '#':
-			escape_if_in_list(&top_node);
-			temp_node = markcore_parse_header(p);
+	// blank lines don't count, so lists and items end at their last text
+	extend_containers(ctx, matched, end);
+	if (matched == stack->size && start_table(ctx, top_node, p, end)) return;
+	
+	// leave what the line didn't continue, a list only stays open for another item of its kind
+	close_containers(ctx, matched);
+	top_node = stack_peek(stack);
+	if (is_list(top_node)) {
+		int same_kind = (block.type == MC_BLOCK_BULLET && top_node->type == UNORDERED_LIST_NODE) ||
+						(block.type == MC_BLOCK_ORDERED && top_node->type == ORDERED_LIST_NODE);
+		if (!same_kind) close_containers(ctx, stack->size - 1);
+	}
+	
+	char *text = block.start;
+	while (block.container && stack->size < MC_MAX_CONTAINER_DEPTH) {
+		ctx->table_node = NULL;
+		if (block.type == MC_BLOCK_QUOTE) {
+			if (!open_container(ctx, BLOCKQUOTE_NODE, block.start, end)) return;
+		} else {
+			if (!open_list_item(ctx, &block, p, end)) return;
+		}
+		
+		p = block.content;
+		text = p; // items keep the blank after their marker
+		classify_block_start(p, &block);
+		if (block.type != MC_BLOCK_PARAGRAPH) text = block.start;
+	}
+	if (block.container) block.type = MC_BLOCK_PARAGRAPH; // too deep, the marker stays text
+	if (block.type == MC_BLOCK_BLANK) return;
+	
+	top_node = stack_peek(stack);
+	MCNode_t *root = stack->items[0];
+	
+	if (ctx->table_node) {
+		MCNode_t *last = top_node->child_count > 0 ? top_node->children[top_node->child_count - 1] : NULL;
+		if (block.type == MC_BLOCK_PARAGRAPH && last == ctx->table_node) {
+			add_table_row(ctx, ctx->table_node, block.start, end, 0);
+			return;
+		}
+		ctx->table_node = NULL;
+	}
+	
+	MCNode_t *temp_node; // for header / image creation
+	
+	switch (block.type) {
+		case MC_BLOCK_HEADER:
+			temp_node = markcore_parse_header(ctx, block.start);
 			if (temp_node) {
-				add_child_node(top_node, temp_node);
+				markcore_add_child_node(top_node, temp_node);
+				// nested headings belong to the top level block they are in
+				if (ctx->headings) heading_index_add(ctx->headings, temp_node, root->child_count - 1);
 				return;
 			}
 			break;
-		case '!': // check for image
-			escape_if_in_list(&top_node);
-			temp_node = markcore_parse_image(p);
+		case MC_BLOCK_IMAGE:
+			temp_node = markcore_parse_image(ctx, block.start);
 			if (temp_node) {
-				add_child_node(top_node, temp_node);
+				markcore_add_child_node(top_node, temp_node);
 				return;
 			}
-			break;
-		case '*': // check for bullet first, then inline
-			if (*(p + 1) == ' ') {
-				// bullet
-				if (top_node->type != UNORDERED_LIST_NODE) {
-					MCNode_t *list_node = create_node(UNORDERED_LIST_NODE, NULL);
-					add_child_node(top_node, list_node);
-					stack_push(node_stack, list_node);
-					top_node = list_node;
-				}
-				p++; // advance over bullet point
-			}
-			break;
-		case '`': // code blocks not inline
-		
-			if (strncmp(p, "```", 3) == 0) {
-				// code block!
-				if (top_node->type != CODE_BLOCK_NODE) {
-					MCNode_t *code_block_node = create_node(CODE_BLOCK_NODE, NULL);
-					add_child_node(top_node, code_block_node);
-					stack_push(node_stack, code_block_node);
-					top_node = code_block_node;
-					return; // start next line
-				} else {
-					(void)stack_pop(node_stack);
-					top_node = stack_peek(node_stack);
-					return; // start next line
-				}
-			}
-			
-			break;
+			break; // not an image after all, plain text
+		case MC_BLOCK_FENCE:
+			temp_node = open_container(ctx, CODE_BLOCK_NODE, block.start, end);
+			if (temp_node) set_code_language(ctx, temp_node, block.start, end);
+			return; // start next line
 		default:
-		
-			if (is_ordered_list_item(&p)) {
-				// ordered list
-				if (top_node->type != ORDERED_LIST_NODE) {
-					MCNode_t *list_node = create_node(ORDERED_LIST_NODE, NULL);
-					add_child_node(top_node, list_node);
-					stack_push(node_stack, list_node);
-					top_node = list_node;
-				}	
-			} else {
-				escape_if_in_list(&top_node);
-			} 
-			// else if (top_node->type == UNORDERED_LIST_NODE || top_node->type == ORDERED_LIST_NODE) {
-// 				// skip multi line
-// 				(void)stack_pop(node_stack);
-// 				top_node = stack_peek(node_stack);
-// 			}
+			break;
 	}
 	
-	MCNode_t *line_node = create_node(LINE_NODE, NULL);
-	stack_push(node_stack, line_node);
-	add_child_node(top_node, line_node);
-	markcore_parse_inline_range(p, start+len);
-	(void)stack_pop(node_stack);	
+	add_paragraph_line(ctx, top_node, p, text, end);
 }
 
 void markcore_free_syntax_tree(MCNode_t *node) {
 	// 	DFS, free buffers and free nodes
 	if (!node) return;
 	
-	if (node->content) free(node->content);
-	if (node->data) free(node->data);
+	// shared subtrees go once their last holder lets go
+	if (atomic_fetch_sub_explicit(&node->refcount, 1, memory_order_acq_rel) != 1) return;
+	
+	if (node->content && !(node->flags & MC_NODE_BORROWED_CONTENT)) mc_free(node->content);
+	if (node->data && !(node->flags & MC_NODE_BORROWED_DATA)) mc_free(node->data);
 	
 	for (int i = 0; i < node->child_count; i++) {
 		MCNode_t *child = node->children[i];
 		markcore_free_syntax_tree(child);
 	}
 	
-	if (node->children) free(node->children);
+	if (node->children) mc_free(node->children);
 	
-	free(node);
+	mc_free(node);
 	
 }
 
@@ -488,7 +1288,7 @@ static void debug_print_range(const char *start, const char *end, const char *la
         return;
     }
     size_t len = end - start;
-    char *buffer = malloc(len + 1);
+    char *buffer = mc_malloc(len + 1);
     if (!buffer) {
         fprintf(stderr, "[DEBUG] %s: failed to allocate buffer\n", label ? label : "range");
         return;
@@ -496,7 +1296,7 @@ static void debug_print_range(const char *start, const char *end, const char *la
     memcpy(buffer, start, len);
     buffer[len] = '\0';
     printf("[DEBUG] %s: \"%s\"\n", label ? label : "range", buffer);
-    free(buffer);
+    mc_free(buffer);
 }
 
 void markcore_print_tree(MCNode_t *node, int depth) {
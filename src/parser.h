@@ -2,12 +2,124 @@
 #define MARKCORE_PARSER_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include "markcore.h"
 #include "types.h"
+#include "stack.h"
+#include "url_table.h"
+#include "headings.h"
+#include "block_index.h"
+#include "intern.h"
+
+// Paragraph buffer bytes from buffer_offset on were copied from source_offset on
+typedef struct {
+	size_t buffer_offset;
+	size_t source_offset;
+} MCSourceSegment_t;
+
+#define MC_MAX_CONTAINER_DEPTH 32 // nested quotes and list items, deeper markers stay text
+#define MC_TABLE_MAX_COLUMNS 128
+
+// Per parse state, the parser itself keeps no globals
+typedef struct MCParserContext {
+	Stack_t *node_stack; // managed by the parser, open containers (quotes, lists, items, code block) between lines
+	
+	MCUrlTable_t *urls; // optional, link/image urls are interned and rewritten here
+	MCHeadingIndex_t *headings; // optional, headers are indexed and given anchors
+	MCBlockIndex_t *blocks; // optional, source offset of each top level block
+	MCInternTable_t *strings; // optional, node strings are interned instead of copied
+	
+	// lines of the open code block, kept as one source span
+	const char *code_start;
+	const char *code_end;
+	int code_escapable;
+	
+	int line_newline; // the line being parsed ended with '\n' (long lines come in chunks)
+	
+	// open table, rows are added while lines keep being plain text
+	MCNode_t *table_node;
+	int table_columns;
+	uint8_t table_align[MC_TABLE_MAX_COLUMNS];
+	
+	// open paragraph, its lines are joined with '\n' and inline parsed once it ends
+	MCNode_t *para_node;
+	char *para_buf;
+	size_t para_len;
+	size_t para_capacity;
+	
+	// optional, nodes get MC_NODE_HAS_POSITION source ranges. Pointers into the line buffer,
+	// the paragraph buffer (one segment per line) or the source are mapped back to offsets
+	int positions;
+	MCBlockIndex_t *lines; // optional, start offset of every source line
+	const char *source;
+	const char *line_buf;
+	size_t line_offset;
+	MCSourceSegment_t *para_segments;
+	size_t para_segment_count;
+	size_t para_segment_capacity;
+	
+	// optional, timed inline parses. line_number is the line being parsed, para_line
+	// the one the open paragraph started on
+	MarkCoreInlineProfile_f inline_profile;
+	void *inline_profile_userdata;
+	size_t line_number;
+	size_t para_line;
+	
+	MarkCoreLimits_t limits; // zeroed fields are unlimited
+	MarkCoreStatus_e status; // first limit that tripped
+	size_t node_count;
+	uint64_t start_us;
+} MCParserContext_t;
 
 // Parse full markdown buffer and return tree
 MCNode_t *markcore_parse(const char *markdown, size_t len);
+MCNode_t *markcore_parse_with_context(MCParserContext_t *ctx, const char *markdown, size_t len);
+
+// Drops one reference, the node (and what only it holds) is freed with the last one
 void markcore_free_syntax_tree(MCNode_t *root);
 
+// Tree construction (content is copied). New nodes have one reference, the caller's.
+// add_child_node takes over the caller's reference to child, retain first to keep one
+MCNode_t *markcore_create_node(MCNodeType_e type, const char *content);
+void markcore_add_child_node(MCNode_t *parent, MCNode_t *child);
+
+/*
+Copy-on-write trees. Nodes are reference counted, so a tree can be shared between
+snapshots: readers keep their root, an edit copies the nodes on the path to the change
+and shares every other subtree with the old tree. Shared nodes are never changed in place
+(add_child_node and splice_children refuse them).
+*/
+MCNode_t *markcore_node_retain(MCNode_t *node);
+int markcore_node_is_shared(const MCNode_t *node);
+
+// Unshared copy of one node, its children are shared
+MCNode_t *markcore_node_copy(const MCNode_t *node);
+
+// New root with unshared copies of the nodes along path (child indexes, depth of them), leaf
+// set to the copy at the end of it. NULL if the path doesn't exist
+MCNode_t *markcore_tree_copy_path(MCNode_t *root, const int *path, size_t depth, MCNode_t **leaf);
+
+// Replace remove_count children from index with insert (references taken over), 0 on failure
+int markcore_splice_children(MCNode_t *parent, int index, int remove_count, MCNode_t **insert, int insert_count);
+
+// Bytes held by a tree: node structs, child arrays (capacity, not count) and owned strings.
+// Shared subtrees are counted each time they are reached
+typedef struct {
+	size_t nodes;
+	size_t children;
+	size_t strings;
+} MCTreeMemory_t;
+
+void markcore_tree_memory(MCNode_t *root, MCTreeMemory_t *memory);
+
+// Trim child arrays to their child count, skipping shared nodes (readers may be walking them).
+// Returns bytes released
+size_t markcore_tree_shrink(MCNode_t *root);
+
+// Replace a node string with an owned (mc_malloc) one, freeing the old one only if the node owned it
+void markcore_node_set_content(MCNode_t *node, char *content);
+void markcore_node_set_data(MCNode_t *node, char *data);
+
 // DEBUG ======================================
 
 void markcore_print_tree(MCNode_t *root, int depth);
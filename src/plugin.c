@@ -0,0 +1,66 @@
+#include "plugin.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+MCPassPipeline_t *pass_pipeline_create(void) {
+	return mc_calloc(1, sizeof(MCPassPipeline_t));
+}
+
+void pass_pipeline_destroy(MCPassPipeline_t *p) {
+	mc_free(p);
+}
+
+int pass_pipeline_register(MCPassPipeline_t *p, const MarkCorePass_t *pass) {
+	if (!p || !pass) return 0;
+	
+	if (pass->version != MARKCORE_PASS_VERSION) {
+		fprintf(stderr, "[Plugin] Unknown pass version %d, dropping pass %s\n", pass->version, pass->name ? pass->name : "(unnamed)");
+		return 0;
+	}
+	
+	if (p->pass_count >= MC_MAX_PASSES) {
+		fprintf(stderr, "[Plugin] Pipeline full, dropping pass %s\n", pass->name ? pass->name : "(unnamed)");
+		return 0;
+	}
+	
+	uint8_t index = (uint8_t)p->pass_count;
+	p->passes[index] = *pass;
+	p->pass_count++;
+	
+	for (int type = 0; type < NODE_TYPE_COUNT; type++) {
+		if (!(pass->node_mask & MARKCORE_NODE_MASK(type))) continue;
+		
+		if (pass->pre) p->pre_visitors[type][p->pre_count[type]++] = index;
+		if (pass->post) p->post_visitors[type][p->post_count[type]++] = index;
+	}
+	
+	return 1;
+}
+
+void pass_pipeline_pre(MCPassPipeline_t *p, const MCNode_t *node) {
+	MCNodeType_e type = node->type;
+	for (int i = 0; i < p->pre_count[type]; i++) {
+		const MarkCorePass_t *pass = &p->passes[p->pre_visitors[type][i]];
+		pass->pre(node, pass->userdata);
+	}
+}
+
+void pass_pipeline_post(MCPassPipeline_t *p, const MCNode_t *node) {
+	MCNodeType_e type = node->type;
+	for (int i = 0; i < p->post_count[type]; i++) {
+		const MarkCorePass_t *pass = &p->passes[p->post_visitors[type][i]];
+		pass->post(node, pass->userdata);
+	}
+}
+
+void pass_pipeline_run(MCPassPipeline_t *p, const MCNode_t *node) {
+	if (!p || !node) return;
+	
+	pass_pipeline_pre(p, node);
+	for (int i = 0; i < node->child_count; i++) {
+		pass_pipeline_run(p, node->children[i]);
+	}
+	pass_pipeline_post(p, node);
+}
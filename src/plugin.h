@@ -0,0 +1,48 @@
+#ifndef MARKCORE_PLUGIN_H
+#define MARKCORE_PLUGIN_H
+
+#include <stdint.h>
+
+#include "markcore.h"
+#include "types.h"
+
+/*
+Pre/post traversal passes (spellcheck, link rewriting, ...), MarkCorePass_t in markcore.h.
+
+Each pass declares the node types it visits. The pipeline builds a per type
+dispatch list so every node only calls the passes that asked for it, and the
+renderer runs the pipeline inside its own walk, so N passes + render is still
+a single traversal with no copy of the tree.
+
+Order for each node: pre hooks (registration order) -> render open -> children
+-> render close -> post hooks. Hooks get the node const: it may be shared with
+snapshots, and the renderer reads interned ids, the escaped string cache and
+MC_NODE_ESCAPE_FREE rather than the content alone, so edits can't be made safely.
+*/
+
+#define MC_MAX_PASSES 16
+
+struct MCPassPipeline {
+	MarkCorePass_t passes[MC_MAX_PASSES];
+	int pass_count;
+	
+	// indexes into passes, per node type
+	uint8_t pre_visitors[NODE_TYPE_COUNT][MC_MAX_PASSES];
+	uint8_t post_visitors[NODE_TYPE_COUNT][MC_MAX_PASSES];
+	uint8_t pre_count[NODE_TYPE_COUNT];
+	uint8_t post_count[NODE_TYPE_COUNT];
+};
+
+MCPassPipeline_t *pass_pipeline_create(void);
+void pass_pipeline_destroy(MCPassPipeline_t *p);
+
+// Pass is copied, returns 0 if the pipeline is full or the pass version is unknown
+int pass_pipeline_register(MCPassPipeline_t *p, const MarkCorePass_t *pass);
+
+void pass_pipeline_pre(MCPassPipeline_t *p, const MCNode_t *node);
+void pass_pipeline_post(MCPassPipeline_t *p, const MCNode_t *node);
+
+// Walk without rendering
+void pass_pipeline_run(MCPassPipeline_t *p, const MCNode_t *root);
+
+#endif
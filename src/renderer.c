@@ -1,6 +1,10 @@
 
 #include "renderer.h"
+#include "alloc.h"
+#include "plugin.h"
+
 #include <stdio.h>
+#include <string.h>
 
 // Macros
 
@@ -18,15 +22,8 @@
 void renderer_destroy(Renderer_t *r) {
 	if (!r) return;
 	stack_free(r->node_stack);
-	free(r);
-}
-
-static size_t traverse_children(Renderer_t *r, MCNode_t *node) {
-	size_t bytes_written = 0;
-	for (int i = 0; i < node->child_count; i++) {
-		bytes_written += render_syntax_tree(r, node->children[i]);
-	}
-	return bytes_written;
+	mc_free(r->state);
+	mc_free(r);
 }
 
 // Handlers ===========================================
@@ -48,27 +45,77 @@ static size_t traverse_children(Renderer_t *r, MCNode_t *node) {
 // 	}
 // }
 
-static size_t handle_list(Renderer_t *r, MCNode_t *node) {
+// node types pushed on the renderer stack, stable addresses so open/close can be split
+static const MCNodeType_e stacked_node_types[NODE_TYPE_COUNT] = {
+	[UNORDERED_LIST_NODE] = UNORDERED_LIST_NODE,
+	[ORDERED_LIST_NODE] = ORDERED_LIST_NODE,
+	[CODE_BLOCK_NODE] = CODE_BLOCK_NODE,
+	[LIST_ITEM_NODE] = LIST_ITEM_NODE,
+	[BLOCKQUOTE_NODE] = BLOCKQUOTE_NODE,
+	[TABLE_NODE] = TABLE_NODE,
+};
 
+// replaces an item's entry once its first block has rendered
+static const MCNodeType_e used_list_item = LIST_ITEM_NODE;
+
+// code block whose highlighted HTML went out on open, its text nodes are skipped
+static const MCNodeType_e highlighted_code_block = CODE_BLOCK_NODE;
+
+static int in_list_item(MCNodeType_e *top_node_type) {
+	return top_node_type && *top_node_type == LIST_ITEM_NODE;
+}
+
+// blocks after the first in a list item are separated like top level ones
+static size_t block_open(Renderer_t *r) {
+	
 	size_t bytes_written = 0;
+	
+	MCNodeType_e *top_node_type = stack_peek(r->node_stack);
+	if (top_node_type == &used_list_item) {
+		SAFE_RENDER_CALL(r, render_line_end);
+	} else if (top_node_type == &stacked_node_types[LIST_ITEM_NODE]) {
+		(void)stack_pop(r->node_stack);
+		stack_push(r->node_stack, (void *)&used_list_item);
+	}
+	
+	return bytes_written;
+}
 
-	if (node->type != UNORDERED_LIST_NODE && node->type != ORDERED_LIST_NODE) {
-		fprintf(stderr, "[Renderer] List handler passed wrong node type\n");
+// the item's close ends the line of its last block
+static size_t block_close(Renderer_t *r) {
+	
+	size_t bytes_written = 0;
+	
+	if (!in_list_item(stack_peek(r->node_stack))) {
+		SAFE_RENDER_CALL(r, render_line_end);
 	}
+	
+	return bytes_written;
+}
+
+static size_t handle_list_open(Renderer_t *r, MCNodeType_e type) {
+
+	size_t bytes_written = block_open(r);
 
-	size_t (*render_list_open)(Renderer_t*) = (node->type == UNORDERED_LIST_NODE) ? r->render_unordered_list_open : r->render_ordered_list_open;
-	size_t (*render_list_close)(Renderer_t*) = (node->type == UNORDERED_LIST_NODE) ? r->render_unordered_list_close : r->render_ordered_list_close;
+	size_t (*render_list_open)(Renderer_t*) = (type == UNORDERED_LIST_NODE) ? r->render_unordered_list_open : r->render_ordered_list_open;
 
 	if (render_list_open) {
 		bytes_written += render_list_open(r);
 	} else {
 		fprintf(stderr, "[Renderer warning] list_open not implemented\n");
-		return 0;
 	}
-		
-	MCNodeType_e list_node = node->type;
-	stack_push(r->node_stack, &list_node);
-	bytes_written += traverse_children(r, node);
+	
+	stack_push(r->node_stack, (void *)&stacked_node_types[type]);
+	
+	return bytes_written;
+}
+
+static size_t handle_list_close(Renderer_t *r, MCNodeType_e type) {
+
+	size_t bytes_written = 0;
+
+	size_t (*render_list_close)(Renderer_t*) = (type == UNORDERED_LIST_NODE) ? r->render_unordered_list_close : r->render_ordered_list_close;
+	
 	(void)stack_pop(r->node_stack);
 	
 	if (render_list_close) {
@@ -77,104 +124,374 @@ static size_t handle_list(Renderer_t *r, MCNode_t *node) {
 		fprintf(stderr, "[Renderer warning] list_close not implemented\n");
 	}
 	
-	SAFE_RENDER_CALL(r, render_line_end);
+	bytes_written += block_close(r);
 	
 	return bytes_written;
 }
 
-// using recursion here so I can swap in specific renderers
-size_t render_syntax_tree(Renderer_t *r, MCNode_t *node) {
+// Code text ready to write. *owned is set when the escaped copy was made here, mc_free() it
+static const char *escaped_code(Renderer_t *r, const MCNode_t *node, size_t *len, char **owned) {
+	*owned = NULL;
+	
+	if ((node->flags & MC_NODE_ESCAPE_FREE && r->honor_escape_free) || !r->escape) {
+		*len = strlen(node->content);
+		return node->content;
+	}
+	
+	if (r->strings && node->content_id != MC_NO_STRING_ID) {
+		return intern_table_escaped(r->strings, node->content_id, r->escape, len);
+	}
+	
+	*len = strlen(node->content);
+	*owned = r->escape(node->content, *len, len);
+	return *owned ? *owned : node->content;
+}
 
-	if (!node) return 0;
+static size_t render_code_block_text(Renderer_t *r, const MCNode_t *node) {
+	size_t bytes_written = 0;
+	
+	// without a cached or clean copy, stream it through the renderer's own escaping
+	int clean = (node->flags & MC_NODE_ESCAPE_FREE) && r->honor_escape_free;
+	int cached = r->strings && node->content_id != MC_NO_STRING_ID;
+	if (!r->escape || !r->render_raw || !(clean || cached)) {
+		SAFE_RENDER_CALL(r, render_code_block_line, node->content);
+		return bytes_written;
+	}
+	
+	size_t len;
+	char *owned;
+	const char *text = escaped_code(r, node, &len, &owned);
+	SAFE_RENDER_CALL(r, render_raw, text, len);
+	mc_free(owned);
+	return bytes_written;
+}
+
+/*
+Highlighted HTML for the whole block in place of its text. Nested blocks hold a text node
+per line, those are joined first. Returns 0 when there is nothing to highlight or the
+highlighter declined, the block then renders its text nodes as usual.
+*/
+static int render_highlighted_code(Renderer_t *r, const MCNode_t *node, size_t *written) {
+	if (node->child_count == 0) return 0;
+	
+	const char *code = node->children[0]->content;
+	size_t len = code ? strlen(code) : 0;
+	char *joined = NULL;
+	
+	if (node->child_count > 1) {
+		len = 0;
+		for (int i = 0; i < node->child_count; i++) len += strlen(node->children[i]->content);
+		
+		joined = mc_malloc(len + 1);
+		if (!joined) return 0;
+		size_t at = 0;
+		for (int i = 0; i < node->child_count; i++) {
+			size_t line_len = strlen(node->children[i]->content);
+			memcpy(joined + at, node->children[i]->content, line_len);
+			at += line_len;
+		}
+		joined[len] = '\0';
+		code = joined;
+	}
+	if (!code) return 0;
+	
+	size_t html_len;
+	char *owned;
+	const char *html = highlight_code(r->highlighter, node->data, code, len, &html_len, &owned);
+	mc_free(joined);
+	if (!html) return 0;
+	
+	size_t bytes_written = 0;
+	SAFE_RENDER_CALL(r, render_raw, html, html_len);
+	free(owned);
+	*written += bytes_written;
+	return 1;
+}
+
+// Open/close halves of each node, shared by every tree walker (MCNode_t trees, serialized blobs)
+
+size_t render_node_open(Renderer_t *r, const MCNode_t *node) {
 	
 	size_t bytes_written = 0;
 	
+	MCNodeType_e type = node->type;
+	const char *content = node->content;
+	const char *data = node->data;
+	
+	const char *escaped;
+	size_t escaped_len;
+	char *owned;
+	
 	MCNodeType_e *top_node_type = stack_peek(r->node_stack);
 	
-	switch (node->type) {
+	r->position_node = (r->lines && (node->flags & MC_NODE_HAS_POSITION)) ? node : NULL;
+	
+	switch (type) {
 		case LINE_NODE:
-			if (top_node_type && (*top_node_type == UNORDERED_LIST_NODE || *top_node_type == ORDERED_LIST_NODE)) {
-				SAFE_RENDER_CALL(r, render_list_item_open);
-			}
-			
+			bytes_written += block_open(r);
 			SAFE_RENDER_CALL(r, render_paragraph_open);
-			bytes_written += traverse_children(r, node);
-			SAFE_RENDER_CALL(r, render_paragraph_close);
-			
-			if (top_node_type && (*top_node_type == UNORDERED_LIST_NODE || *top_node_type == ORDERED_LIST_NODE)) {
-				SAFE_RENDER_CALL(r, render_list_item_close);
-			}
-			
-			SAFE_RENDER_CALL(r, render_line_end);
-			
 			break;
 		case ROOT_NODE:
-			bytes_written += traverse_children(r, node);
+			if (r->render_document_open) bytes_written += r->render_document_open(r);
 			break;
 		
 		case CODE_BLOCK_NODE:
-			SAFE_RENDER_CALL(r, render_code_block_open); 
-			MCNodeType_e code_block_node = CODE_BLOCK_NODE;
-			stack_push(r->node_stack, &code_block_node);
-			bytes_written += traverse_children(r, node);
-			(void)stack_pop(r->node_stack);
-			SAFE_RENDER_CALL(r, render_code_block_close); 
+			bytes_written += block_open(r);
+			SAFE_RENDER_CALL(r, render_code_block_open, data); 
+			if (r->highlighter && render_highlighted_code(r, node, &bytes_written)) {
+				stack_push(r->node_stack, (void *)&highlighted_code_block);
+			} else {
+				stack_push(r->node_stack, (void *)&stacked_node_types[CODE_BLOCK_NODE]);
+			}
 			break;	
 		
 		case CODE_INLINE_NODE:
-			SAFE_RENDER_CALL(r, render_code_inline, node->content);
+			escaped = escaped_code(r, node, &escaped_len, &owned);
+			SAFE_RENDER_CALL(r, render_code_inline, escaped, escaped_len);
+			mc_free(owned);
 			break;
 		
 		case IMAGE_NODE:
-			SAFE_RENDER_CALL(r, render_image, node->data, node->content);
-			SAFE_RENDER_CALL(r, render_line_end);
+			bytes_written += block_open(r);
+			SAFE_RENDER_CALL(r, render_image, data, content);
+			bytes_written += block_close(r);
 			break;
 
 		case TEXT_NODE: 
 				
-			if (top_node_type && *top_node_type == CODE_BLOCK_NODE) {
-				SAFE_RENDER_CALL(r, render_code_block_line, node->content);
-				SAFE_RENDER_CALL(r, render_line_end);
+			if (top_node_type == &highlighted_code_block) {
+				break; // written with the block
+			} else if (top_node_type && *top_node_type == CODE_BLOCK_NODE) {
+				// the whole block is one text node, newlines included
+				bytes_written += render_code_block_text(r, node);
 			} else {
-				SAFE_RENDER_CALL(r, render_text, node->content);
+				SAFE_RENDER_CALL(r, render_text, content);
 			}
 		
 			break;
 			
 		case HEADER_NODE:
-			SAFE_RENDER_CALL(r, render_header, node->header_level, node->content);
-			SAFE_RENDER_CALL(r, render_line_end);
+			bytes_written += block_open(r);
+			SAFE_RENDER_CALL(r, render_header, node->header_level, content, data);
+			bytes_written += block_close(r);
 			break;
 		
 		case UNORDERED_LIST_NODE:
 		case ORDERED_LIST_NODE:
-			bytes_written += handle_list(r, node);
+			bytes_written += handle_list_open(r, type);
+			break;
+		case LIST_ITEM_NODE:
+			SAFE_RENDER_CALL(r, render_list_item_open);
+			stack_push(r->node_stack, (void *)&stacked_node_types[LIST_ITEM_NODE]);
+			break;
+		
+		case BLOCKQUOTE_NODE:
+			bytes_written += block_open(r);
+			SAFE_RENDER_CALL(r, render_blockquote_open);
+			stack_push(r->node_stack, (void *)&stacked_node_types[BLOCKQUOTE_NODE]);
+			break;
+		
+		case TABLE_NODE:
+			bytes_written += block_open(r);
+			SAFE_RENDER_CALL(r, render_table_open);
+			stack_push(r->node_stack, (void *)&stacked_node_types[TABLE_NODE]);
+			break;
+		case TABLE_ROW_NODE:
+			SAFE_RENDER_CALL(r, render_table_row_open, node->table_info & MC_TABLE_HEADER);
+			break;
+		case TABLE_CELL_NODE:
+			SAFE_RENDER_CALL(r, render_table_cell_open, node->table_info & MC_TABLE_HEADER, node->table_info & MC_TABLE_ALIGN_MASK);
 			break;
 		
 		case BOLD_NODE:
 			SAFE_RENDER_CALL(r, render_bold_open); 
-			bytes_written += traverse_children(r, node);
-			SAFE_RENDER_CALL(r, render_bold_close); 
 			break;
 		case ITALIC_NODE:
 			SAFE_RENDER_CALL(r, render_italic_open); 
-			bytes_written += traverse_children(r, node);
-			SAFE_RENDER_CALL(r, render_italic_close); 
 			break;
 		case BOLD_ITALIC_NODE:
 			SAFE_RENDER_CALL(r, render_bold_open); 
 			SAFE_RENDER_CALL(r, render_italic_open); 
-			bytes_written += traverse_children(r, node);
-			SAFE_RENDER_CALL(r, render_italic_close); 
-			SAFE_RENDER_CALL(r, render_bold_close); 
 			break;
 		case LINK_NODE:
-			SAFE_RENDER_CALL(r, render_link, node->data, node->content);
+			SAFE_RENDER_CALL(r, render_link, data, content);
+			break;
+		default:
+			printf("Not implemented renderer for: %s", type_labels[type]);
+	}
+	
+	r->position_node = NULL;
+	return bytes_written;
+}
+
+size_t render_node_close(Renderer_t *r, const MCNode_t *node) {
+
+	size_t bytes_written = 0;
+	
+	MCNodeType_e type = node->type;
+	
+	switch (type) {
+		case LINE_NODE:
+			SAFE_RENDER_CALL(r, render_paragraph_close);
+			bytes_written += block_close(r);
+			break;
+		
+		case ROOT_NODE:
+			if (r->render_document_close) bytes_written += r->render_document_close(r);
+			break;
+		
+		case CODE_BLOCK_NODE:
+			(void)stack_pop(r->node_stack);
+			SAFE_RENDER_CALL(r, render_code_block_close); 
+			break;
+		
+		case UNORDERED_LIST_NODE:
+		case ORDERED_LIST_NODE:
+			bytes_written += handle_list_close(r, type);
+			break;
+		case LIST_ITEM_NODE:
+			(void)stack_pop(r->node_stack);
+			SAFE_RENDER_CALL(r, render_list_item_close);
+			SAFE_RENDER_CALL(r, render_line_end);
+			break;
+		
+		case BLOCKQUOTE_NODE:
+			(void)stack_pop(r->node_stack);
+			SAFE_RENDER_CALL(r, render_blockquote_close);
+			bytes_written += block_close(r);
+			break;
+		
+		case TABLE_NODE:
+			(void)stack_pop(r->node_stack);
+			SAFE_RENDER_CALL(r, render_table_close);
+			bytes_written += block_close(r);
+			break;
+		case TABLE_ROW_NODE:
+			SAFE_RENDER_CALL(r, render_table_row_close, node->table_info & MC_TABLE_HEADER);
+			break;
+		case TABLE_CELL_NODE:
+			SAFE_RENDER_CALL(r, render_table_cell_close, node->table_info & MC_TABLE_HEADER);
+			break;
+		
+		case BOLD_NODE:
+			SAFE_RENDER_CALL(r, render_bold_close); 
+			break;
+		case ITALIC_NODE:
+			SAFE_RENDER_CALL(r, render_italic_close); 
+			break;
+		case BOLD_ITALIC_NODE:
+			SAFE_RENDER_CALL(r, render_italic_close); 
+			SAFE_RENDER_CALL(r, render_bold_close); 
 			break;
 		default:
-			printf("Not implemented renderer for: %s", type_labels[node->type]);
+			break; // leaf nodes render entirely on open
 	}
 	
 	return bytes_written;
+}
+
+int render_take_source_range(Renderer_t *r, MCSourceRange_t *range) {
+	const MCNode_t *node = r->position_node;
+	if (!node) return 0;
+	r->position_node = NULL;
+	
+	uint32_t last = node->source_end > node->source_start ? node->source_end - 1 : node->source_start;
+	block_index_line_column(r->lines, node->source_start, &range->start_line, &range->start_column);
+	block_index_line_column(r->lines, last, &range->end_line, &range->end_column);
+	return 1;
+}
+
+int render_limit_reached(Renderer_t *r) {
+	if (!r->max_output_bytes || r->output_bytes < r->max_output_bytes) return 0;
+	r->truncated = 1;
+	return 1;
+}
+
+// Cursor ===========================================
+
+#define RENDER_CURSOR_INITIAL_DEPTH 16
+
+static int push_frame(MCRenderCursor_t *c, MCNode_t *node) {
+	if (c->depth == c->capacity) {
+		size_t capacity = c->capacity ? c->capacity * 2 : RENDER_CURSOR_INITIAL_DEPTH;
+		MCRenderFrame_t *frames = mc_realloc(c->frames, sizeof(MCRenderFrame_t) * capacity);
+		if (!frames) return 0;
+		c->frames = frames;
+		c->capacity = capacity;
+	}
+	
+	c->frames[c->depth].node = node;
+	c->frames[c->depth].next_child = -1;
+	c->depth++;
+	return 1;
+}
+
+int render_cursor_begin(MCRenderCursor_t *c, Renderer_t *r, MCNode_t *root) {
+	c->r = r;
+	c->frames = NULL;
+	c->depth = 0;
+	c->capacity = 0;
+	c->bytes_written = 0;
+	return root ? push_frame(c, root) : 1;
+}
+
+int render_cursor_step(MCRenderCursor_t *c) {
+	if (c->depth == 0) return 0;
+	
+	Renderer_t *r = c->r;
+	MCRenderFrame_t *frame = &c->frames[c->depth - 1];
+	MCNode_t *node = frame->node;
+	
+	if (frame->next_child < 0) {
+		// nodes starting past the output limit are skipped whole
+		if (render_limit_reached(r)) {
+			c->depth--;
+			return 1;
+		}
+		
+		if (r->passes) pass_pipeline_pre(r->passes, node);
+		
+		size_t open_bytes = render_node_open(r, node);
+		r->output_bytes += open_bytes;
+		c->bytes_written += open_bytes;
+		frame->next_child = 0;
+		return 1;
+	}
+	
+	if (frame->next_child < node->child_count) {
+		MCNode_t *child = node->children[frame->next_child++];
+		if (child && !push_frame(c, child)) {
+			fprintf(stderr, "[Renderer] Failed to grow cursor stack\n");
+		}
+		return 1;
+	}
+	
+	// always close what was opened so truncated output stays well formed
+	size_t close_bytes = render_node_close(r, node);
+	r->output_bytes += close_bytes;
+	c->bytes_written += close_bytes;
 	
-}
\ No newline at end of file
+	if (r->passes) pass_pipeline_post(r->passes, node);
+	
+	c->depth--;
+	return 1;
+}
+
+void render_cursor_end(MCRenderCursor_t *c) {
+	mc_free(c->frames);
+	c->frames = NULL;
+	c->depth = 0;
+	c->capacity = 0;
+}
+
+// walks with a cursor so deep trees don't recurse, and so streaming renders share the walk
+size_t render_syntax_tree(Renderer_t *r, MCNode_t *node) {
+
+	MCRenderCursor_t cursor;
+	if (!render_cursor_begin(&cursor, r, node)) return 0;
+	
+	while (render_cursor_step(&cursor));
+	
+	render_cursor_end(&cursor);
+	return cursor.bytes_written;
+}
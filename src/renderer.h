@@ -5,15 +5,47 @@
 
 #include "types.h"
 #include "stack.h"
+#include "intern.h"
+#include "sink.h"
+#include "block_index.h"
+#include "highlight.h"
+
+struct MCPassPipeline; // plugin.h
 
 typedef struct Renderer {
 
-	Stack_t *node_stack; // list state
+	Stack_t *node_stack; // open containers (lists, items, quotes, tables, code)
+	
+	struct MCPassPipeline *passes; // optional, run inside the render walk
+	
+	// code text is escaped through escape and written with render_raw. Content the parser
+	// flagged MC_NODE_ESCAPE_FREE is written as is, interned content is escaped once per table
+	MCInternTable_t *strings;
+	MCEscape_f escape; // NULL passes code text to the callbacks unescaped
+	int honor_escape_free; // MC_NODE_ESCAPE_FREE content is clean for this renderer's escaping
+	
+	size_t max_output_bytes; // 0 for no limit, nodes starting past it are skipped
+	size_t output_bytes;
+	int truncated;
+	
+	// optional, line starts for data-sourcepos style annotations. position_node is the
+	// node being opened while it has a position nobody has taken yet
+	MCBlockIndex_t *lines;
+	const MCNode_t *position_node;
 	
-	FILE *outfile;
+	// optional, highlighted HTML replaces the text of code blocks, written with render_raw
+	const MCHighlighter_t *highlighter;
+	
+	MCSink_t *sink;
+	void *state; // renderer specific, mc_free()d with the renderer
+	
+	// optional, around a whole document (ROOT_NODE)
+	size_t (*render_document_open)(struct Renderer*);
+	size_t (*render_document_close)(struct Renderer*);
 
-	size_t (*render_header)(struct Renderer*, int header_level, const char *text);	
+	size_t (*render_header)(struct Renderer*, int header_level, const char *text, const char *id);	
 	size_t (*render_text)(struct Renderer*, const char *text);
+	size_t (*render_raw)(struct Renderer*, const char *text, size_t len); // already escaped
 	size_t (*render_image)(struct Renderer*, const char *url, const char *alt);
 	size_t (*render_link)(struct Renderer*, const char *url, const char *text);
 	
@@ -22,11 +54,11 @@ typedef struct Renderer {
 	size_t (*render_paragraph_open)(struct Renderer*);
 	size_t (*render_paragraph_close)(struct Renderer*);
 	
-	size_t (*render_code_block_open)(struct Renderer*);
+	size_t (*render_code_block_open)(struct Renderer*, const char *lang); // lang NULL without an info string
 	size_t (*render_code_block_close)(struct Renderer*);
-	size_t (*render_code_block_line)(struct Renderer*, const char *text);
+	size_t (*render_code_block_line)(struct Renderer*, const char *text); // unescaped, used without escape/render_raw
 	
-	size_t (*render_code_inline)(struct Renderer*, const char *text);
+	size_t (*render_code_inline)(struct Renderer*, const char *text, size_t len); // already escaped
 	
 	size_t (*render_bold_open)(struct Renderer*);
 	size_t (*render_bold_close)(struct Renderer*);
@@ -41,9 +73,59 @@ typedef struct Renderer {
 	
 	size_t (*render_list_item_open)(struct Renderer*);
 	size_t (*render_list_item_close)(struct Renderer*);
+	
+	size_t (*render_blockquote_open)(struct Renderer*);
+	size_t (*render_blockquote_close)(struct Renderer*);
+	
+	// header is set for the first row, align is one of MC_TABLE_ALIGN_*
+	size_t (*render_table_open)(struct Renderer*);
+	size_t (*render_table_close)(struct Renderer*);
+	size_t (*render_table_row_open)(struct Renderer*, int header);
+	size_t (*render_table_row_close)(struct Renderer*, int header);
+	size_t (*render_table_cell_open)(struct Renderer*, int header, int align);
+	size_t (*render_table_cell_close)(struct Renderer*, int header);
 } Renderer_t;
 
 size_t render_syntax_tree(Renderer_t *r, MCNode_t *node);
+
+// Resumable walk behind render_syntax_tree. Each step renders one node open or close, so
+// a caller can stop between steps (when its sink has enough buffered) and carry on later
+typedef struct {
+	MCNode_t *node;
+	int next_child; // -1 until the node is opened
+} MCRenderFrame_t;
+
+typedef struct RenderCursor {
+	Renderer_t *r;
+	MCRenderFrame_t *frames;
+	size_t depth;
+	size_t capacity;
+	size_t bytes_written;
+} MCRenderCursor_t;
+
+int render_cursor_begin(MCRenderCursor_t *c, Renderer_t *r, MCNode_t *root);
+int render_cursor_step(MCRenderCursor_t *c); // 0 once the tree is finished
+void render_cursor_end(MCRenderCursor_t *c);
+
+// per-node halves of render_syntax_tree, children are not visited. Walkers over other tree
+// representations pass a childless MCNode_t filled in on the stack
+size_t render_node_open(Renderer_t *r, const MCNode_t *node);
+size_t render_node_close(Renderer_t *r, const MCNode_t *node);
+
+// 1 based, inclusive line/column range of the node being opened (needs lines). Only the first
+// call per node gets it, so a node rendered as nested tags annotates the outer one
+typedef struct {
+	size_t start_line;
+	size_t start_column;
+	size_t end_line;
+	size_t end_column;
+} MCSourceRange_t;
+
+int render_take_source_range(Renderer_t *r, MCSourceRange_t *range);
+
+// output limit check for tree walkers, sets truncated
+int render_limit_reached(Renderer_t *r);
+
 void renderer_destroy(Renderer_t *r); // clean up stack
 
 #endif
\ No newline at end of file
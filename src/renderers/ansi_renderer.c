@@ -0,0 +1,324 @@
+#include "ansi_renderer.h"
+#include "../alloc.h"
+#include "../escape.h"
+
+#include <string.h>
+
+#define ANSI_MAX_LIST_DEPTH 16
+
+#define ANSI_RESET "\x1b[0m"
+#define ANSI_BOLD "\x1b[1m"
+#define ANSI_NORMAL_INTENSITY "\x1b[22m"
+#define ANSI_ITALIC "\x1b[3m"
+#define ANSI_NO_ITALIC "\x1b[23m"
+#define ANSI_UNDERLINE "\x1b[4m"
+#define ANSI_NO_UNDERLINE "\x1b[24m"
+#define ANSI_CODE "\x1b[36m"
+#define ANSI_DEFAULT_COLOR "\x1b[39m"
+#define ANSI_FAINT "\x1b[2m"
+
+typedef struct {
+	int list_depth;
+	int ordered[ANSI_MAX_LIST_DEPTH];
+	int item_number[ANSI_MAX_LIST_DEPTH];
+	int quote_depth;
+	int table_cell; // cells written in the current row
+} MCAnsiState_t;
+
+// Forward Declaration ======================================
+
+static size_t ansi_render_header(Renderer_t *r, int header_level, const char *text, const char *id);
+static size_t ansi_render_text(Renderer_t *r, const char *text);
+static size_t ansi_render_raw(Renderer_t *r, const char *text, size_t len);
+static size_t ansi_render_image(Renderer_t *r, const char *url, const char *alt);
+static size_t ansi_render_link(Renderer_t *r, const char *url, const char *text);
+
+static size_t ansi_render_line_end(Renderer_t *r);
+
+static size_t ansi_render_paragraph_open(Renderer_t *r);
+static size_t ansi_render_paragraph_close(Renderer_t *r);
+
+static size_t ansi_render_code_block_open(Renderer_t *r, const char *lang);
+static size_t ansi_render_code_block_close(Renderer_t *r);
+static size_t ansi_render_code_block_line(Renderer_t *r, const char *text);
+static size_t ansi_render_code_inline(Renderer_t *r, const char *text, size_t len);
+
+static size_t ansi_render_bold_open(Renderer_t *r);
+static size_t ansi_render_bold_close(Renderer_t *r);
+
+static size_t ansi_render_italic_open(Renderer_t *r);
+static size_t ansi_render_italic_close(Renderer_t *r);
+
+static size_t ansi_render_unordered_list_open(Renderer_t *r);
+static size_t ansi_render_ordered_list_open(Renderer_t *r);
+static size_t ansi_render_list_close(Renderer_t *r);
+
+static size_t ansi_render_list_item_open(Renderer_t *r);
+static size_t ansi_render_list_item_close(Renderer_t *r);
+
+static size_t ansi_render_blockquote_open(Renderer_t *r);
+static size_t ansi_render_blockquote_close(Renderer_t *r);
+
+static size_t ansi_render_nothing(Renderer_t *r);
+static size_t ansi_render_table_row_open(Renderer_t *r, int header);
+static size_t ansi_render_table_row_close(Renderer_t *r, int header);
+static size_t ansi_render_table_cell_open(Renderer_t *r, int header, int align);
+static size_t ansi_render_table_cell_close(Renderer_t *r, int header);
+
+// Renderer =================================================
+
+Renderer_t *create_ansi_renderer(MCSink_t *sink) {
+	
+	Renderer_t *r = mc_calloc(1, sizeof(Renderer_t));
+	if (!r) return NULL;
+	
+	r->state = mc_calloc(1, sizeof(MCAnsiState_t));
+	if (!r->state) {
+		mc_free(r);
+		return NULL;
+	}
+	
+	r->sink = sink;
+	r->node_stack = stack_create(4);
+	r->passes = NULL;
+	
+	// code reaches the callbacks unescaped, they sanitize while writing
+	r->escape = NULL;
+	
+	r->render_header = ansi_render_header;
+	r->render_text = ansi_render_text;
+	r->render_raw = ansi_render_raw;
+	r->render_image = ansi_render_image;
+	r->render_link = ansi_render_link;
+	
+	r->render_line_end = ansi_render_line_end;
+	
+	r->render_paragraph_open = ansi_render_paragraph_open;
+	r->render_paragraph_close = ansi_render_paragraph_close;
+	
+	r->render_code_block_open = ansi_render_code_block_open;
+	r->render_code_block_close = ansi_render_code_block_close;
+	r->render_code_block_line = ansi_render_code_block_line;
+	
+	r->render_code_inline = ansi_render_code_inline;
+	
+	r->render_bold_open = ansi_render_bold_open;
+	r->render_bold_close = ansi_render_bold_close;
+	
+	r->render_italic_open = ansi_render_italic_open;
+	r->render_italic_close = ansi_render_italic_close;
+	
+	r->render_unordered_list_open = ansi_render_unordered_list_open;
+	r->render_unordered_list_close = ansi_render_list_close;
+	r->render_ordered_list_open = ansi_render_ordered_list_open;
+	r->render_ordered_list_close = ansi_render_list_close;
+	
+	r->render_list_item_open = ansi_render_list_item_open;
+	r->render_list_item_close = ansi_render_list_item_close;
+	
+	r->render_blockquote_open = ansi_render_blockquote_open;
+	r->render_blockquote_close = ansi_render_blockquote_close;
+	
+	r->render_table_open = ansi_render_nothing;
+	r->render_table_close = ansi_render_nothing;
+	r->render_table_row_open = ansi_render_table_row_open;
+	r->render_table_row_close = ansi_render_table_row_close;
+	r->render_table_cell_open = ansi_render_table_cell_open;
+	r->render_table_cell_close = ansi_render_table_cell_close;
+	
+	return r;
+}
+
+// Helpers ==============================================
+
+static size_t ansi_text(Renderer_t *r, const char *text) {
+	return text ? escape_to_sink(r->sink, MC_ESCAPE_TERMINAL, text, strlen(text)) : 0;
+}
+
+static size_t ansi_list_open(Renderer_t *r, int ordered) {
+	MCAnsiState_t *state = r->state;
+	if (state->list_depth < ANSI_MAX_LIST_DEPTH) {
+		state->ordered[state->list_depth] = ordered;
+		state->item_number[state->list_depth] = 0;
+	}
+	state->list_depth++;
+	return 0;
+}
+
+// a bar per open quote in front of the block's first line
+static size_t ansi_quote_prefix(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	size_t written = 0;
+	for (int i = 0; i < state->quote_depth; i++) written += sink_puts(r->sink, ANSI_FAINT "\xe2\x94\x82 " ANSI_NORMAL_INTENSITY);
+	return written;
+}
+
+// Renderer Functions ==============================================
+
+static size_t ansi_render_header(Renderer_t *r, int header_level, const char *text, const char *id) {
+	(void)id;
+	if (!text) return 0;
+	while (*text == ' ' || *text == '\t') text++;
+	
+	size_t written = sink_puts(r->sink, header_level <= 2 ? ANSI_BOLD ANSI_UNDERLINE : ANSI_BOLD);
+	written += ansi_text(r, text);
+	written += sink_puts(r->sink, ANSI_RESET "\n");
+	return written;
+}
+
+static size_t ansi_render_text(Renderer_t *r, const char *text) {
+	return ansi_text(r, text);
+}
+
+static size_t ansi_render_raw(Renderer_t *r, const char *text, size_t len) {
+	return escape_to_sink(r->sink, MC_ESCAPE_TERMINAL, text, len);
+}
+
+static size_t ansi_render_image(Renderer_t *r, const char *url, const char *alt) {
+	size_t written = sink_puts(r->sink, ANSI_FAINT "[image: ");
+	written += ansi_text(r, alt);
+	written += sink_puts(r->sink, "] ");
+	written += ansi_text(r, url);
+	written += sink_puts(r->sink, ANSI_RESET);
+	return written;
+}
+
+static size_t ansi_render_link(Renderer_t *r, const char *url, const char *text) {
+	size_t written = sink_puts(r->sink, ANSI_UNDERLINE);
+	written += ansi_text(r, text);
+	written += sink_puts(r->sink, ANSI_NO_UNDERLINE ANSI_FAINT " (");
+	written += ansi_text(r, url);
+	written += sink_puts(r->sink, ")" ANSI_NORMAL_INTENSITY);
+	return written;
+}
+
+static size_t ansi_render_line_end(Renderer_t *r) {
+	return sink_puts(r->sink, "\n");
+}
+
+// list items carry the prefix themselves
+static size_t ansi_render_paragraph_open(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	return state->list_depth == 0 ? ansi_quote_prefix(r) : 0;
+}
+
+// blank line between paragraphs, list items stay tight
+static size_t ansi_render_paragraph_close(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	return state->list_depth == 0 ? sink_puts(r->sink, "\n") : 0;
+}
+
+static size_t ansi_render_code_block_open(Renderer_t *r, const char *lang) {
+	(void)lang;
+	return sink_puts(r->sink, ANSI_CODE);
+}
+
+static size_t ansi_render_code_block_close(Renderer_t *r) {
+	return sink_puts(r->sink, ANSI_DEFAULT_COLOR "\n");
+}
+
+static size_t ansi_render_code_block_line(Renderer_t *r, const char *text) {
+	return ansi_text(r, text);
+}
+
+static size_t ansi_render_code_inline(Renderer_t *r, const char *text, size_t len) {
+	size_t written = sink_puts(r->sink, ANSI_CODE);
+	written += escape_to_sink(r->sink, MC_ESCAPE_TERMINAL, text, len);
+	written += sink_puts(r->sink, ANSI_DEFAULT_COLOR);
+	return written;
+}
+
+static size_t ansi_render_bold_open(Renderer_t *r) {
+	return sink_puts(r->sink, ANSI_BOLD);
+}
+
+static size_t ansi_render_bold_close(Renderer_t *r) {
+	return sink_puts(r->sink, ANSI_NORMAL_INTENSITY);
+}
+
+static size_t ansi_render_italic_open(Renderer_t *r) {
+	return sink_puts(r->sink, ANSI_ITALIC);
+}
+
+static size_t ansi_render_italic_close(Renderer_t *r) {
+	return sink_puts(r->sink, ANSI_NO_ITALIC);
+}
+
+static size_t ansi_render_unordered_list_open(Renderer_t *r) {
+	return ansi_list_open(r, 0);
+}
+
+static size_t ansi_render_ordered_list_open(Renderer_t *r) {
+	return ansi_list_open(r, 1);
+}
+
+static size_t ansi_render_list_close(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	if (state->list_depth > 0) state->list_depth--;
+	return 0;
+}
+
+static size_t ansi_render_list_item_open(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	int level = state->list_depth > 0 ? state->list_depth - 1 : 0;
+	
+	size_t written = ansi_quote_prefix(r);
+	for (int i = 0; i < level; i++) written += sink_puts(r->sink, "  ");
+	
+	if (level < ANSI_MAX_LIST_DEPTH && state->ordered[level]) {
+		written += sink_printf(r->sink, "%i.", ++state->item_number[level]);
+	} else {
+		written += sink_puts(r->sink, "\xe2\x80\xa2"); // bullet
+	}
+	return written;
+}
+
+static size_t ansi_render_list_item_close(Renderer_t *r) {
+	(void)r;
+	return 0;
+}
+
+static size_t ansi_render_blockquote_open(Renderer_t *r) {
+	((MCAnsiState_t *)r->state)->quote_depth++;
+	return 0;
+}
+
+static size_t ansi_render_blockquote_close(Renderer_t *r) {
+	MCAnsiState_t *state = r->state;
+	if (state->quote_depth > 0) state->quote_depth--;
+	return 0;
+}
+
+static size_t ansi_render_nothing(Renderer_t *r) {
+	(void)r;
+	return 0;
+}
+
+// header row in bold, cells split by a faint bar
+static size_t ansi_render_table_row_open(Renderer_t *r, int header) {
+	((MCAnsiState_t *)r->state)->table_cell = 0;
+	
+	size_t written = ansi_quote_prefix(r);
+	if (header) written += sink_puts(r->sink, ANSI_BOLD);
+	return written;
+}
+
+static size_t ansi_render_table_row_close(Renderer_t *r, int header) {
+	return sink_puts(r->sink, header ? ANSI_NORMAL_INTENSITY "\n" : "\n");
+}
+
+static size_t ansi_render_table_cell_open(Renderer_t *r, int header, int align) {
+	(void)align;
+	MCAnsiState_t *state = r->state;
+	if (state->table_cell++ == 0) return 0;
+	
+	// the separator's intensity change would end the header's bold
+	return sink_puts(r->sink, header ? ANSI_NORMAL_INTENSITY ANSI_FAINT " \xe2\x94\x82 " ANSI_NORMAL_INTENSITY ANSI_BOLD
+									 : ANSI_FAINT " \xe2\x94\x82 " ANSI_NORMAL_INTENSITY);
+}
+
+static size_t ansi_render_table_cell_close(Renderer_t *r, int header) {
+	(void)r;
+	(void)header;
+	return 0;
+}
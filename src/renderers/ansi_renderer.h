@@ -0,0 +1,11 @@
+
+#ifndef ANSI_RENDERER_H
+#define ANSI_RENDERER_H
+
+#include "../renderer.h"
+
+// Styled text for terminals (SGR escape sequences). Control characters in the
+// document are replaced so content can't inject its own sequences
+Renderer_t *create_ansi_renderer(MCSink_t *sink);
+
+#endif
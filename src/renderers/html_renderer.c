@@ -1,12 +1,21 @@
 
 #include "html_renderer.h"
+#include "../alloc.h"
+#include "../escape.h"
 
-#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+	int table_body; // <tbody> is open, body rows follow the header
+	const MCHtmlTemplate_t *tmpl; // markup of the elements it sets, NULL for the built-in markup
+} MCHtmlState_t;
 
 // Forward Declaration ======================================
 
-static size_t html_render_header(Renderer_t *r, int header_level, const char *text);
+static size_t html_render_header(Renderer_t *r, int header_level, const char *text, const char *id);
 static size_t html_render_text(Renderer_t *r,  const char *text);
+static size_t html_render_raw(Renderer_t *r, const char *text, size_t len);
 static size_t html_render_image(Renderer_t *r, const char *url, const char *alt);
 static size_t html_render_link(Renderer_t *r, const char *url, const char *text);
 
@@ -15,10 +24,10 @@ static size_t html_render_line_end(Renderer_t* r);
 static size_t html_render_paragraph_open(Renderer_t *r);
 static size_t html_render_paragraph_close(Renderer_t *r);
 
-static size_t html_render_code_block_open(Renderer_t *r);
+static size_t html_render_code_block_open(Renderer_t *r, const char *lang);
 static size_t html_render_code_block_close(Renderer_t *r);
 static size_t html_render_code_block_line(Renderer_t *r, const char *text);
-static size_t html_render_code_inline(Renderer_t *r, const char *text);
+static size_t html_render_code_inline(Renderer_t *r, const char *text, size_t len);
 
 static size_t html_render_bold_open(Renderer_t *r);
 static size_t html_render_bold_close(Renderer_t *r);
@@ -34,18 +43,56 @@ static size_t html_render_ordered_list_close(Renderer_t *r);
 static size_t html_render_list_item_open(Renderer_t *r);
 static size_t html_render_list_item_close(Renderer_t *r);
 
+static size_t html_render_blockquote_open(Renderer_t *r);
+static size_t html_render_blockquote_close(Renderer_t *r);
+
+static size_t html_render_table_open(Renderer_t *r);
+static size_t html_render_table_close(Renderer_t *r);
+static size_t html_render_table_row_open(Renderer_t *r, int header);
+static size_t html_render_table_row_close(Renderer_t *r, int header);
+static size_t html_render_table_cell_open(Renderer_t *r, int header, int align);
+static size_t html_render_table_cell_close(Renderer_t *r, int header);
+
+// data-sourcepos attribute of the block being opened, NULL when not rendering positions
+#define HTML_SOURCEPOS_SIZE 96
+
+static const char *html_sourcepos(Renderer_t *r, char *attr) {
+	MCSourceRange_t range;
+	if (!render_take_source_range(r, &range)) return NULL;
+	snprintf(attr, HTML_SOURCEPOS_SIZE, " data-sourcepos=\"%zu:%zu-%zu:%zu\"",
+			 range.start_line, range.start_column, range.end_line, range.end_column);
+	return attr;
+}
+
+// plain tags stay a single puts unless there is an attribute to add
+static size_t html_open_tag(Renderer_t *r, const char *plain, const char *name) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	if (!html_sourcepos(r, attr)) return sink_puts(r->sink, plain);
+	return sink_printf(r->sink, "<%s%s>", name, attr);
+}
+
 // Renderer =================================================
 
-Renderer_t *create_html_renderer(FILE *dest) {
+Renderer_t *create_html_renderer(MCSink_t *sink) {
 	
-	Renderer_t *r = malloc(sizeof(Renderer_t));
+	Renderer_t *r = mc_calloc(1, sizeof(Renderer_t));
 	if (!r) return NULL;
 	
-	r->outfile = dest;
+	r->state = mc_calloc(1, sizeof(MCHtmlState_t));
+	if (!r->state) {
+		mc_free(r);
+		return NULL;
+	}
+	
+	r->sink = sink;
 	r->node_stack = stack_create(4);
+	r->passes = NULL;
 	
 	r->render_header = html_render_header;
 	r->render_text = html_render_text;
+	r->render_raw = html_render_raw;
+	r->escape = escape_html_copy;
+	r->honor_escape_free = 1;
 	r->render_image = html_render_image;
 	r->render_link = html_render_link;
 	
@@ -74,130 +121,357 @@ Renderer_t *create_html_renderer(FILE *dest) {
 	r->render_list_item_open = html_render_list_item_open;
 	r->render_list_item_close = html_render_list_item_close;
 	
+	r->render_blockquote_open = html_render_blockquote_open;
+	r->render_blockquote_close = html_render_blockquote_close;
+	
+	r->render_table_open = html_render_table_open;
+	r->render_table_close = html_render_table_close;
+	r->render_table_row_open = html_render_table_row_open;
+	r->render_table_row_close = html_render_table_row_close;
+	r->render_table_cell_open = html_render_table_cell_open;
+	r->render_table_cell_close = html_render_table_cell_close;
+	
 	return r;
 }
 
-static size_t html_emit(FILE *outfile, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    int written = vfprintf(outfile, fmt, args);
-    va_end(args);
-
-    return (written < 0) ? 0 : (size_t)written;
-}
-
 // Renderer Functions ==============================================
 
-static size_t html_render_header(Renderer_t *r, int header_level, const char *text) {
-	return html_emit(r->outfile, "<h%i>%s</h%i>", header_level, text, header_level);
+static size_t html_render_header(Renderer_t *r, int header_level, const char *text, const char *id) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	const char *pos = html_sourcepos(r, attr);
+	if (!pos) pos = "";
+	
+	if (id) {
+		return sink_printf(r->sink, "<h%i%s id=\"%s\">%s</h%i>", header_level, pos, id, text, header_level);
+	}
+	return sink_printf(r->sink, "<h%i%s>%s</h%i>", header_level, pos, text, header_level);
 }
 
 static size_t html_render_text(Renderer_t *r,  const char *text) {
-	return html_emit(r->outfile, "%s", text);
+	return sink_puts(r->sink, text);
+}
+
+static size_t html_render_raw(Renderer_t *r, const char *text, size_t len) {
+	return sink_write(r->sink, text, len);
 }
 
 static size_t html_render_image(Renderer_t *r, const char *url, const char *alt) {
-	return html_emit(r->outfile, "<img src=\"%s\" alt=\"%s\" />", url, alt);
+	char attr[HTML_SOURCEPOS_SIZE];
+	const char *pos = html_sourcepos(r, attr);
+	return sink_printf(r->sink, "<img%s src=\"%s\" alt=\"%s\" />", pos ? pos : "", url, alt);
 }
 
 static size_t html_render_link(Renderer_t *r, const char *url, const char *text) {
-	return html_emit(r->outfile, "<a href=\"%s\">%s</a>", url, text);
+	return sink_printf(r->sink, "<a href=\"%s\">%s</a>", url, text);
 }
 
 static size_t html_render_paragraph_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<p>");
+	return html_open_tag(r, "<p>", "p");
 }
 
 static size_t html_render_paragraph_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</p>");
+	return sink_puts(r->sink, "</p>");
 }
 
-static size_t html_render_code_block_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<pre><code>");
+static size_t html_render_code_block_open(Renderer_t *r, const char *lang) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	const char *pos = html_sourcepos(r, attr);
+	if (!lang) {
+		if (!pos) return sink_puts(r->sink, "<pre><code>");
+		return sink_printf(r->sink, "<pre%s><code>", pos);
+	}
+	
+	size_t written = sink_printf(r->sink, "<pre%s><code class=\"language-", pos ? pos : "");
+	written += escape_to_sink(r->sink, MC_ESCAPE_HTML, lang, strlen(lang));
+	written += sink_puts(r->sink, "\">");
+	return written;
 }
 
 static size_t html_render_code_block_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</code></pre>");
+	return sink_puts(r->sink, "</code></pre>");
 }
 
 static size_t html_render_code_block_line(Renderer_t *r, const char *text) {
-    size_t written = 0;
-    for (const char *p = text; *p; p++) {
-        switch (*p) {
-            case '&':
-                fputs("&amp;", r->outfile);
-                written += 5;
-                break;
-            case '<':
-                fputs("&lt;", r->outfile);
-                written += 4;
-                break;
-            case '>':
-                fputs("&gt;", r->outfile);
-                written += 4;
-                break;
-            case '"':
-                fputs("&quot;", r->outfile);
-                written += 6;
-                break;
-            case '\'':
-                fputs("&#39;", r->outfile);
-                written += 5;
-                break;
-            default:
-                fputc(*p, r->outfile);
-                written += 1;
-                break;
-        }
-    }
-
-    return written;
-}
-
-static size_t html_render_code_inline(Renderer_t *r, const char *text) {
-	return html_emit(r->outfile, "<code>%s</code>", text);
+	return escape_to_sink(r->sink, MC_ESCAPE_HTML, text, strlen(text));
+}
+
+static size_t html_render_code_inline(Renderer_t *r, const char *text, size_t len) {
+	size_t written = sink_puts(r->sink, "<code>");
+	written += sink_write(r->sink, text, len);
+	written += sink_puts(r->sink, "</code>");
+	return written;
 }
 
 static size_t html_render_line_end(Renderer_t* r) {
-	return html_emit(r->outfile, "\n");
+	return sink_puts(r->sink, "\n");
 }
 
 static size_t html_render_bold_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<strong>");
+	return sink_puts(r->sink, "<strong>");
 }
 
 static size_t html_render_bold_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</strong>");
+	return sink_puts(r->sink, "</strong>");
 }
 
 static size_t html_render_italic_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<em>");
+	return sink_puts(r->sink, "<em>");
 }
 
 static size_t html_render_italic_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</em>");
+	return sink_puts(r->sink, "</em>");
 }
 
 static size_t html_render_unordered_list_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<ul>");
+	return html_open_tag(r, "<ul>", "ul");
 }
 
 static size_t html_render_unordered_list_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</ul>");
+	return sink_puts(r->sink, "</ul>");
 }
 
 static size_t html_render_ordered_list_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<ol>");
+	return html_open_tag(r, "<ol>", "ol");
 }
 
 static size_t html_render_ordered_list_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</ol>");
+	return sink_puts(r->sink, "</ol>");
 }
 
 static size_t html_render_list_item_open(Renderer_t *r) {
-	return html_emit(r->outfile, "<li>");
+	return html_open_tag(r, "<li>", "li");
 }
 
 static size_t html_render_list_item_close(Renderer_t *r) {
-	return html_emit(r->outfile, "</li>");
-}
\ No newline at end of file
+	return sink_puts(r->sink, "</li>");
+}
+static size_t html_render_blockquote_open(Renderer_t *r) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	if (!html_sourcepos(r, attr)) return sink_puts(r->sink, "<blockquote>\n");
+	return sink_printf(r->sink, "<blockquote%s>\n", attr);
+}
+
+static size_t html_render_blockquote_close(Renderer_t *r) {
+	return sink_puts(r->sink, "</blockquote>");
+}
+
+static size_t html_render_table_open(Renderer_t *r) {
+	((MCHtmlState_t *)r->state)->table_body = 0;
+	
+	char attr[HTML_SOURCEPOS_SIZE];
+	if (!html_sourcepos(r, attr)) return sink_puts(r->sink, "<table>\n");
+	return sink_printf(r->sink, "<table%s>\n", attr);
+}
+
+static size_t html_render_table_close(Renderer_t *r) {
+	MCHtmlState_t *state = r->state;
+	return sink_puts(r->sink, state->table_body ? "</tbody>\n</table>" : "</table>");
+}
+
+// <tbody> opens with the first body row, header only tables don't get one
+static size_t html_render_table_row_open(Renderer_t *r, int header) {
+	MCHtmlState_t *state = r->state;
+	if (header) return sink_puts(r->sink, "<thead>\n<tr>\n");
+	if (state->table_body) return sink_puts(r->sink, "<tr>\n");
+	
+	state->table_body = 1;
+	return sink_puts(r->sink, "<tbody>\n<tr>\n");
+}
+
+static size_t html_render_table_row_close(Renderer_t *r, int header) {
+	return sink_puts(r->sink, header ? "</tr>\n</thead>\n" : "</tr>\n");
+}
+
+static const char *html_align_names[] = {
+	[MC_TABLE_ALIGN_LEFT] = "left",
+	[MC_TABLE_ALIGN_CENTER] = "center",
+	[MC_TABLE_ALIGN_RIGHT] = "right",
+};
+
+static size_t html_render_table_cell_open(Renderer_t *r, int header, int align) {
+	const char *tag = header ? "th" : "td";
+	if (align == MC_TABLE_ALIGN_NONE) return sink_printf(r->sink, "<%s>", tag);
+	return sink_printf(r->sink, "<%s align=\"%s\">", tag, html_align_names[align]);
+}
+
+static size_t html_render_table_cell_close(Renderer_t *r, int header) {
+	return sink_puts(r->sink, header ? "</th>\n" : "</td>\n");
+}
+
+// Templates ==============================================
+
+static size_t html_emit(Renderer_t *r, MarkCoreTemplateElement_e element, int close, const MCTemplateValues_t values) {
+	const MCHtmlTemplate_t *tmpl = ((MCHtmlState_t *)r->state)->tmpl;
+	return html_template_emit(r->sink, &tmpl->parts[element][close], values);
+}
+
+static size_t html_emit_open(Renderer_t *r, MarkCoreTemplateElement_e element) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	MCTemplateValues_t values = {[MC_SLOT_SOURCEPOS] = html_sourcepos(r, attr)};
+	return html_emit(r, element, 0, values);
+}
+
+static size_t html_emit_close(Renderer_t *r, MarkCoreTemplateElement_e element) {
+	MCTemplateValues_t values = {0};
+	return html_emit(r, element, 1, values);
+}
+
+// elements whose markup has no other slot than {sourcepos}
+#define HTML_TEMPLATE_PAIR(name, element) \
+	static size_t html_template_##name##_open(Renderer_t *r) { return html_emit_open(r, element); } \
+	static size_t html_template_##name##_close(Renderer_t *r) { return html_emit_close(r, element); }
+
+HTML_TEMPLATE_PAIR(paragraph, MARKCORE_TEMPLATE_PARAGRAPH)
+HTML_TEMPLATE_PAIR(bold, MARKCORE_TEMPLATE_BOLD)
+HTML_TEMPLATE_PAIR(italic, MARKCORE_TEMPLATE_ITALIC)
+HTML_TEMPLATE_PAIR(unordered_list, MARKCORE_TEMPLATE_UNORDERED_LIST)
+HTML_TEMPLATE_PAIR(ordered_list, MARKCORE_TEMPLATE_ORDERED_LIST)
+HTML_TEMPLATE_PAIR(list_item, MARKCORE_TEMPLATE_LIST_ITEM)
+HTML_TEMPLATE_PAIR(blockquote, MARKCORE_TEMPLATE_BLOCKQUOTE)
+
+static size_t html_template_header(Renderer_t *r, int header_level, const char *text, const char *id) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	char level[12];
+	snprintf(level, sizeof(level), "%i", header_level);
+	
+	MCTemplateValues_t values = {
+		[MC_SLOT_SOURCEPOS] = html_sourcepos(r, attr),
+		[MC_SLOT_LEVEL] = level,
+		[MC_SLOT_ID] = id,
+		[MC_SLOT_TEXT] = text,
+	};
+	size_t written = html_emit(r, MARKCORE_TEMPLATE_HEADER, 0, values);
+	written += sink_puts(r->sink, text);
+	written += html_emit(r, MARKCORE_TEMPLATE_HEADER, 1, values);
+	return written;
+}
+
+static size_t html_template_code_block_open(Renderer_t *r, const char *lang) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	size_t len;
+	char *escaped = lang ? escape_html_copy(lang, strlen(lang), &len) : NULL;
+	
+	MCTemplateValues_t values = {
+		[MC_SLOT_SOURCEPOS] = html_sourcepos(r, attr),
+		[MC_SLOT_LANG] = escaped ? escaped : lang,
+	};
+	size_t written = html_emit(r, MARKCORE_TEMPLATE_CODE_BLOCK, 0, values);
+	mc_free(escaped);
+	return written;
+}
+
+static size_t html_template_code_block_close(Renderer_t *r) {
+	return html_emit_close(r, MARKCORE_TEMPLATE_CODE_BLOCK);
+}
+
+static size_t html_template_code_inline(Renderer_t *r, const char *text, size_t len) {
+	size_t written = html_emit_open(r, MARKCORE_TEMPLATE_CODE_INLINE);
+	written += sink_write(r->sink, text, len);
+	written += html_emit_close(r, MARKCORE_TEMPLATE_CODE_INLINE);
+	return written;
+}
+
+static size_t html_template_link(Renderer_t *r, const char *url, const char *text) {
+	MCTemplateValues_t values = {[MC_SLOT_URL] = url, [MC_SLOT_TEXT] = text};
+	size_t written = html_emit(r, MARKCORE_TEMPLATE_LINK, 0, values);
+	written += sink_puts(r->sink, text);
+	written += html_emit(r, MARKCORE_TEMPLATE_LINK, 1, values);
+	return written;
+}
+
+static size_t html_template_image(Renderer_t *r, const char *url, const char *alt) {
+	char attr[HTML_SOURCEPOS_SIZE];
+	MCTemplateValues_t values = {
+		[MC_SLOT_SOURCEPOS] = html_sourcepos(r, attr),
+		[MC_SLOT_URL] = url,
+		[MC_SLOT_TEXT] = alt,
+	};
+	size_t written = html_emit(r, MARKCORE_TEMPLATE_IMAGE, 0, values);
+	written += html_emit(r, MARKCORE_TEMPLATE_IMAGE, 1, values);
+	return written;
+}
+
+static size_t html_template_table_open(Renderer_t *r) {
+	((MCHtmlState_t *)r->state)->table_body = 0;
+	return html_emit_open(r, MARKCORE_TEMPLATE_TABLE);
+}
+
+static size_t html_template_table_close(Renderer_t *r) {
+	MCHtmlState_t *state = r->state;
+	size_t written = state->table_body ? sink_puts(r->sink, "</tbody>\n") : 0;
+	return written + html_emit_close(r, MARKCORE_TEMPLATE_TABLE);
+}
+
+static const char *html_align_attributes[] = {
+	[MC_TABLE_ALIGN_NONE] = NULL,
+	[MC_TABLE_ALIGN_LEFT] = " align=\"left\"",
+	[MC_TABLE_ALIGN_CENTER] = " align=\"center\"",
+	[MC_TABLE_ALIGN_RIGHT] = " align=\"right\"",
+};
+
+// one callback for both cell kinds, a kind without a template keeps the built-in markup
+static size_t html_template_table_cell_open(Renderer_t *r, int header, int align) {
+	MCHtmlState_t *state = r->state;
+	MarkCoreTemplateElement_e element = header ? MARKCORE_TEMPLATE_TABLE_HEADER_CELL : MARKCORE_TEMPLATE_TABLE_CELL;
+	if (!state->tmpl->set[element]) return html_render_table_cell_open(r, header, align);
+	
+	MCTemplateValues_t values = {[MC_SLOT_ALIGN] = html_align_attributes[align]};
+	return html_emit(r, element, 0, values);
+}
+
+static size_t html_template_table_cell_close(Renderer_t *r, int header) {
+	MCHtmlState_t *state = r->state;
+	MarkCoreTemplateElement_e element = header ? MARKCORE_TEMPLATE_TABLE_HEADER_CELL : MARKCORE_TEMPLATE_TABLE_CELL;
+	if (!state->tmpl->set[element]) return html_render_table_cell_close(r, header);
+	return html_emit_close(r, element);
+}
+
+void html_renderer_use_template(Renderer_t *r, const MCHtmlTemplate_t *tmpl) {
+	((MCHtmlState_t *)r->state)->tmpl = tmpl;
+	const int *set = tmpl->set;
+	
+	if (set[MARKCORE_TEMPLATE_PARAGRAPH]) {
+		r->render_paragraph_open = html_template_paragraph_open;
+		r->render_paragraph_close = html_template_paragraph_close;
+	}
+	if (set[MARKCORE_TEMPLATE_HEADER]) r->render_header = html_template_header;
+	if (set[MARKCORE_TEMPLATE_CODE_BLOCK]) {
+		r->render_code_block_open = html_template_code_block_open;
+		r->render_code_block_close = html_template_code_block_close;
+	}
+	if (set[MARKCORE_TEMPLATE_CODE_INLINE]) r->render_code_inline = html_template_code_inline;
+	if (set[MARKCORE_TEMPLATE_BOLD]) {
+		r->render_bold_open = html_template_bold_open;
+		r->render_bold_close = html_template_bold_close;
+	}
+	if (set[MARKCORE_TEMPLATE_ITALIC]) {
+		r->render_italic_open = html_template_italic_open;
+		r->render_italic_close = html_template_italic_close;
+	}
+	if (set[MARKCORE_TEMPLATE_LINK]) r->render_link = html_template_link;
+	if (set[MARKCORE_TEMPLATE_IMAGE]) r->render_image = html_template_image;
+	if (set[MARKCORE_TEMPLATE_UNORDERED_LIST]) {
+		r->render_unordered_list_open = html_template_unordered_list_open;
+		r->render_unordered_list_close = html_template_unordered_list_close;
+	}
+	if (set[MARKCORE_TEMPLATE_ORDERED_LIST]) {
+		r->render_ordered_list_open = html_template_ordered_list_open;
+		r->render_ordered_list_close = html_template_ordered_list_close;
+	}
+	if (set[MARKCORE_TEMPLATE_LIST_ITEM]) {
+		r->render_list_item_open = html_template_list_item_open;
+		r->render_list_item_close = html_template_list_item_close;
+	}
+	if (set[MARKCORE_TEMPLATE_BLOCKQUOTE]) {
+		r->render_blockquote_open = html_template_blockquote_open;
+		r->render_blockquote_close = html_template_blockquote_close;
+	}
+	if (set[MARKCORE_TEMPLATE_TABLE]) {
+		r->render_table_open = html_template_table_open;
+		r->render_table_close = html_template_table_close;
+	}
+	if (set[MARKCORE_TEMPLATE_TABLE_HEADER_CELL] || set[MARKCORE_TEMPLATE_TABLE_CELL]) {
+		r->render_table_cell_open = html_template_table_cell_open;
+		r->render_table_cell_close = html_template_table_cell_close;
+	}
+}
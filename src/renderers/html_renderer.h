@@ -3,8 +3,12 @@
 #define HTML_RENDERER_H
 
 #include "../renderer.h"
-#include <stdio.h>
+#include "../html_template.h"
 
-Renderer_t *create_html_renderer(FILE *dest);
+// writes to sink, which has to outlive the renderer
+Renderer_t *create_html_renderer(MCSink_t *sink);
+
+// swaps in the template's markup for the elements it sets, tmpl has to outlive the renderer
+void html_renderer_use_template(Renderer_t *r, const MCHtmlTemplate_t *tmpl);
 
 #endif
\ No newline at end of file
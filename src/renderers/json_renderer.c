@@ -0,0 +1,276 @@
+#include "json_renderer.h"
+#include "../alloc.h"
+#include "../escape.h"
+
+#include <string.h>
+
+typedef struct {
+	int need_comma; // a value was written at the current array level
+} MCJsonState_t;
+
+// Forward Declaration ======================================
+
+static size_t json_render_document_open(Renderer_t *r);
+static size_t json_render_document_close(Renderer_t *r);
+
+static size_t json_render_header(Renderer_t *r, int header_level, const char *text, const char *id);
+static size_t json_render_text(Renderer_t *r, const char *text);
+static size_t json_render_raw(Renderer_t *r, const char *text, size_t len);
+static size_t json_render_image(Renderer_t *r, const char *url, const char *alt);
+static size_t json_render_link(Renderer_t *r, const char *url, const char *text);
+
+static size_t json_render_line_end(Renderer_t *r);
+
+static size_t json_render_paragraph_open(Renderer_t *r);
+static size_t json_render_container_close(Renderer_t *r);
+
+static size_t json_render_code_block_open(Renderer_t *r, const char *lang);
+static size_t json_render_code_block_close(Renderer_t *r);
+static size_t json_render_code_block_line(Renderer_t *r, const char *text);
+static size_t json_render_code_inline(Renderer_t *r, const char *text, size_t len);
+
+static size_t json_render_bold_open(Renderer_t *r);
+static size_t json_render_italic_open(Renderer_t *r);
+
+static size_t json_render_unordered_list_open(Renderer_t *r);
+static size_t json_render_ordered_list_open(Renderer_t *r);
+static size_t json_render_list_item_open(Renderer_t *r);
+
+static size_t json_render_blockquote_open(Renderer_t *r);
+
+static size_t json_render_table_open(Renderer_t *r);
+static size_t json_render_table_row_open(Renderer_t *r, int header);
+static size_t json_render_table_cell_open(Renderer_t *r, int header, int align);
+static size_t json_render_table_part_close(Renderer_t *r, int header);
+
+// Renderer =================================================
+
+Renderer_t *create_json_renderer(MCSink_t *sink) {
+	
+	Renderer_t *r = mc_calloc(1, sizeof(Renderer_t));
+	if (!r) return NULL;
+	
+	r->state = mc_calloc(1, sizeof(MCJsonState_t));
+	if (!r->state) {
+		mc_free(r);
+		return NULL;
+	}
+	
+	r->sink = sink;
+	r->node_stack = stack_create(4);
+	r->passes = NULL;
+	
+	// code text comes escaped for string literals, cached per interned string like html
+	r->escape = escape_json_copy;
+	r->honor_escape_free = 0;
+	
+	r->render_document_open = json_render_document_open;
+	r->render_document_close = json_render_document_close;
+	
+	r->render_header = json_render_header;
+	r->render_text = json_render_text;
+	r->render_raw = json_render_raw;
+	r->render_image = json_render_image;
+	r->render_link = json_render_link;
+	
+	r->render_line_end = json_render_line_end;
+	
+	r->render_paragraph_open = json_render_paragraph_open;
+	r->render_paragraph_close = json_render_container_close;
+	
+	r->render_code_block_open = json_render_code_block_open;
+	r->render_code_block_close = json_render_code_block_close;
+	r->render_code_block_line = json_render_code_block_line;
+	
+	r->render_code_inline = json_render_code_inline;
+	
+	r->render_bold_open = json_render_bold_open;
+	r->render_bold_close = json_render_container_close;
+	
+	r->render_italic_open = json_render_italic_open;
+	r->render_italic_close = json_render_container_close;
+	
+	r->render_unordered_list_open = json_render_unordered_list_open;
+	r->render_unordered_list_close = json_render_container_close;
+	r->render_ordered_list_open = json_render_ordered_list_open;
+	r->render_ordered_list_close = json_render_container_close;
+	
+	r->render_list_item_open = json_render_list_item_open;
+	r->render_list_item_close = json_render_container_close;
+	
+	r->render_blockquote_open = json_render_blockquote_open;
+	r->render_blockquote_close = json_render_container_close;
+	
+	r->render_table_open = json_render_table_open;
+	r->render_table_close = json_render_container_close;
+	r->render_table_row_open = json_render_table_row_open;
+	r->render_table_row_close = json_render_table_part_close;
+	r->render_table_cell_open = json_render_table_cell_open;
+	r->render_table_cell_close = json_render_table_part_close;
+	
+	return r;
+}
+
+// Helpers ==============================================
+
+// comma before every value but the first of an array
+static size_t json_value_start(Renderer_t *r) {
+	MCJsonState_t *state = r->state;
+	size_t written = state->need_comma ? sink_puts(r->sink, ",") : 0;
+	state->need_comma = 1;
+	return written;
+}
+
+static size_t json_string(Renderer_t *r, const char *text) {
+	if (!text) return sink_puts(r->sink, "null");
+	
+	size_t written = sink_puts(r->sink, "\"");
+	written += escape_to_sink(r->sink, MC_ESCAPE_JSON, text, strlen(text));
+	written += sink_puts(r->sink, "\"");
+	return written;
+}
+
+static size_t json_container_open(Renderer_t *r, const char *open) {
+	size_t written = json_value_start(r);
+	written += sink_puts(r->sink, open);
+	((MCJsonState_t *)r->state)->need_comma = 0;
+	return written;
+}
+
+// leaf object {"type":type,"key":value} with string values
+static size_t json_leaf(Renderer_t *r, const char *type, const char *key, const char *value, const char *key2, const char *value2) {
+	size_t written = json_value_start(r);
+	written += sink_printf(r->sink, "{\"type\":\"%s\",\"%s\":", type, key);
+	written += json_string(r, value);
+	if (key2) {
+		written += sink_printf(r->sink, ",\"%s\":", key2);
+		written += json_string(r, value2);
+	}
+	written += sink_puts(r->sink, "}");
+	return written;
+}
+
+// Renderer Functions ==============================================
+
+static size_t json_render_document_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"document\",\"children\":[");
+}
+
+static size_t json_render_document_close(Renderer_t *r) {
+	return sink_puts(r->sink, "]}\n");
+}
+
+static size_t json_render_header(Renderer_t *r, int header_level, const char *text, const char *id) {
+	size_t written = json_value_start(r);
+	written += sink_printf(r->sink, "{\"type\":\"heading\",\"level\":%i,\"id\":", header_level);
+	written += json_string(r, id);
+	written += sink_puts(r->sink, ",\"text\":");
+	written += json_string(r, text);
+	written += sink_puts(r->sink, "}");
+	return written;
+}
+
+static size_t json_render_text(Renderer_t *r, const char *text) {
+	return json_leaf(r, "text", "text", text, NULL, NULL);
+}
+
+static size_t json_render_raw(Renderer_t *r, const char *text, size_t len) {
+	return sink_write(r->sink, text, len);
+}
+
+static size_t json_render_image(Renderer_t *r, const char *url, const char *alt) {
+	return json_leaf(r, "image", "url", url, "alt", alt);
+}
+
+static size_t json_render_link(Renderer_t *r, const char *url, const char *text) {
+	return json_leaf(r, "link", "url", url, "text", text);
+}
+
+static size_t json_render_line_end(Renderer_t *r) {
+	(void)r;
+	return 0;
+}
+
+static size_t json_render_paragraph_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"paragraph\",\"children\":[");
+}
+
+static size_t json_render_container_close(Renderer_t *r) {
+	((MCJsonState_t *)r->state)->need_comma = 1;
+	return sink_puts(r->sink, "]}");
+}
+
+// the block's single text child lands inside the "text" string
+static size_t json_render_code_block_open(Renderer_t *r, const char *lang) {
+	size_t written = json_value_start(r);
+	written += sink_puts(r->sink, "{\"type\":\"code_block\",\"language\":");
+	written += json_string(r, lang);
+	written += sink_puts(r->sink, ",\"text\":\"");
+	return written;
+}
+
+static size_t json_render_code_block_close(Renderer_t *r) {
+	return sink_puts(r->sink, "\"}");
+}
+
+static size_t json_render_code_block_line(Renderer_t *r, const char *text) {
+	return text ? escape_to_sink(r->sink, MC_ESCAPE_JSON, text, strlen(text)) : 0;
+}
+
+static size_t json_render_code_inline(Renderer_t *r, const char *text, size_t len) {
+	size_t written = json_value_start(r);
+	written += sink_puts(r->sink, "{\"type\":\"code\",\"text\":\"");
+	written += sink_write(r->sink, text, len);
+	written += sink_puts(r->sink, "\"}");
+	return written;
+}
+
+static size_t json_render_bold_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"strong\",\"children\":[");
+}
+
+static size_t json_render_italic_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"emphasis\",\"children\":[");
+}
+
+static size_t json_render_unordered_list_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"list\",\"ordered\":false,\"children\":[");
+}
+
+static size_t json_render_ordered_list_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"list\",\"ordered\":true,\"children\":[");
+}
+
+static size_t json_render_list_item_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"list_item\",\"children\":[");
+}
+
+static size_t json_render_blockquote_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"blockquote\",\"children\":[");
+}
+
+static size_t json_render_table_open(Renderer_t *r) {
+	return json_container_open(r, "{\"type\":\"table\",\"children\":[");
+}
+
+static size_t json_render_table_row_open(Renderer_t *r, int header) {
+	return json_container_open(r, header ? "{\"type\":\"table_row\",\"header\":true,\"children\":["
+										 : "{\"type\":\"table_row\",\"header\":false,\"children\":[");
+}
+
+static const char *json_cell_opens[] = {
+	[MC_TABLE_ALIGN_NONE] = "{\"type\":\"table_cell\",\"align\":null,\"children\":[",
+	[MC_TABLE_ALIGN_LEFT] = "{\"type\":\"table_cell\",\"align\":\"left\",\"children\":[",
+	[MC_TABLE_ALIGN_CENTER] = "{\"type\":\"table_cell\",\"align\":\"center\",\"children\":[",
+	[MC_TABLE_ALIGN_RIGHT] = "{\"type\":\"table_cell\",\"align\":\"right\",\"children\":[",
+};
+
+static size_t json_render_table_cell_open(Renderer_t *r, int header, int align) {
+	(void)header;
+	return json_container_open(r, json_cell_opens[align]);
+}
+
+static size_t json_render_table_part_close(Renderer_t *r, int header) {
+	(void)header;
+	return json_render_container_close(r);
+}
@@ -0,0 +1,14 @@
+
+#ifndef JSON_RENDERER_H
+#define JSON_RENDERER_H
+
+#include "../renderer.h"
+
+/*
+JSON syntax tree. Every node is an object with a "type", containers carry "children":
+
+	{"type":"document","children":[{"type":"heading","level":2,"id":"intro","text":"Intro"}, ...]}
+*/
+Renderer_t *create_json_renderer(MCSink_t *sink);
+
+#endif
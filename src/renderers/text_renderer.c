@@ -0,0 +1,168 @@
+#include "text_renderer.h"
+#include "../alloc.h"
+
+#include <string.h>
+
+typedef struct {
+	int table_cell; // cells written in the current row
+} MCTextState_t;
+
+// Forward Declaration ======================================
+
+static size_t text_render_header(Renderer_t *r, int header_level, const char *text, const char *id);
+static size_t text_render_text(Renderer_t *r, const char *text);
+static size_t text_render_raw(Renderer_t *r, const char *text, size_t len);
+static size_t text_render_image(Renderer_t *r, const char *url, const char *alt);
+static size_t text_render_link(Renderer_t *r, const char *url, const char *text);
+
+static size_t text_render_line_end(Renderer_t *r);
+static size_t text_render_nothing(Renderer_t *r);
+
+static size_t text_render_code_block_open(Renderer_t *r, const char *lang);
+static size_t text_render_code_block_line(Renderer_t *r, const char *text);
+static size_t text_render_code_inline(Renderer_t *r, const char *text, size_t len);
+
+static size_t text_render_table_row_open(Renderer_t *r, int header);
+static size_t text_render_table_row_close(Renderer_t *r, int header);
+static size_t text_render_table_cell_open(Renderer_t *r, int header, int align);
+static size_t text_render_table_cell_close(Renderer_t *r, int header);
+
+// Renderer =================================================
+
+Renderer_t *create_text_renderer(MCSink_t *sink) {
+	
+	Renderer_t *r = mc_calloc(1, sizeof(Renderer_t));
+	if (!r) return NULL;
+	
+	r->state = mc_calloc(1, sizeof(MCTextState_t));
+	if (!r->state) {
+		mc_free(r);
+		return NULL;
+	}
+	
+	r->sink = sink;
+	r->node_stack = stack_create(4);
+	r->passes = NULL;
+	
+	// text goes out as written, nothing to escape
+	r->escape = NULL;
+	
+	r->render_header = text_render_header;
+	r->render_text = text_render_text;
+	r->render_raw = text_render_raw;
+	r->render_image = text_render_image;
+	r->render_link = text_render_link;
+	
+	r->render_line_end = text_render_line_end;
+	
+	r->render_paragraph_open = text_render_nothing;
+	r->render_paragraph_close = text_render_nothing;
+	
+	r->render_code_block_open = text_render_code_block_open;
+	r->render_code_block_close = text_render_nothing;
+	r->render_code_block_line = text_render_code_block_line;
+	
+	r->render_code_inline = text_render_code_inline;
+	
+	r->render_bold_open = text_render_nothing;
+	r->render_bold_close = text_render_nothing;
+	
+	r->render_italic_open = text_render_nothing;
+	r->render_italic_close = text_render_nothing;
+	
+	r->render_unordered_list_open = text_render_nothing;
+	r->render_unordered_list_close = text_render_nothing;
+	r->render_ordered_list_open = text_render_nothing;
+	r->render_ordered_list_close = text_render_nothing;
+	
+	r->render_list_item_open = text_render_nothing;
+	r->render_list_item_close = text_render_nothing;
+	
+	r->render_blockquote_open = text_render_nothing;
+	r->render_blockquote_close = text_render_nothing;
+	
+	// rows on their own line, cells tab separated
+	r->render_table_open = text_render_nothing;
+	r->render_table_close = text_render_nothing;
+	r->render_table_row_open = text_render_table_row_open;
+	r->render_table_row_close = text_render_table_row_close;
+	r->render_table_cell_open = text_render_table_cell_open;
+	r->render_table_cell_close = text_render_table_cell_close;
+	
+	return r;
+}
+
+// Renderer Functions ==============================================
+
+static size_t text_render_header(Renderer_t *r, int header_level, const char *text, const char *id) {
+	(void)header_level;
+	(void)id;
+	if (!text) return 0;
+	while (*text == ' ' || *text == '\t') text++;
+	return sink_puts(r->sink, text);
+}
+
+static size_t text_render_text(Renderer_t *r, const char *text) {
+	return text ? sink_puts(r->sink, text) : 0;
+}
+
+static size_t text_render_raw(Renderer_t *r, const char *text, size_t len) {
+	return sink_write(r->sink, text, len);
+}
+
+static size_t text_render_image(Renderer_t *r, const char *url, const char *alt) {
+	(void)url;
+	return alt ? sink_puts(r->sink, alt) : 0;
+}
+
+static size_t text_render_link(Renderer_t *r, const char *url, const char *text) {
+	(void)url;
+	return text ? sink_puts(r->sink, text) : 0;
+}
+
+static size_t text_render_line_end(Renderer_t *r) {
+	return sink_puts(r->sink, "\n");
+}
+
+static size_t text_render_nothing(Renderer_t *r) {
+	(void)r;
+	return 0;
+}
+
+static size_t text_render_code_block_open(Renderer_t *r, const char *lang) {
+	(void)r;
+	(void)lang;
+	return 0;
+}
+
+static size_t text_render_code_block_line(Renderer_t *r, const char *text) {
+	return text ? sink_puts(r->sink, text) : 0;
+}
+
+static size_t text_render_code_inline(Renderer_t *r, const char *text, size_t len) {
+	return sink_write(r->sink, text, len);
+}
+
+static size_t text_render_table_row_open(Renderer_t *r, int header) {
+	(void)header;
+	((MCTextState_t *)r->state)->table_cell = 0;
+	return 0;
+}
+
+static size_t text_render_table_row_close(Renderer_t *r, int header) {
+	(void)header;
+	return sink_puts(r->sink, "\n");
+}
+
+static size_t text_render_table_cell_open(Renderer_t *r, int header, int align) {
+	(void)header;
+	(void)align;
+	MCTextState_t *state = r->state;
+	return state->table_cell++ > 0 ? sink_puts(r->sink, "\t") : 0;
+}
+
+static size_t text_render_table_cell_close(Renderer_t *r, int header) {
+	(void)r;
+	(void)header;
+	return 0;
+}
@@ -0,0 +1,10 @@
+
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include "../renderer.h"
+
+// Plain text, markup dropped, one line per block. For search indexing and previews
+Renderer_t *create_text_renderer(MCSink_t *sink);
+
+#endif
@@ -0,0 +1,305 @@
+#include "serialize.h"
+#include "alloc.h"
+#include "parser.h"
+#include "intern.h"
+
+#include <string.h>
+#include <stdio.h>
+
+typedef struct {
+	uint8_t *blob;
+	size_t nodes_offset;
+	uint32_t node_index;
+	
+	// each distinct string is written once, offsets are per intern id
+	MCInternTable_t *strings;
+	uint32_t *string_offsets;
+} MCBlobWriter_t;
+
+typedef struct {
+	const uint8_t *blob;
+	const char *strings;
+	uint32_t node_count;
+	uint32_t strings_size;
+} MCBlobReader_t;
+
+// Writing ======================================================
+
+static int collect_tree(MCNode_t *node, int depth, size_t *node_count, MCInternTable_t *strings) {
+	if (depth >= MC_BLOB_MAX_DEPTH) {
+		fprintf(stderr, "[Serialize] Tree deeper than %d\n", MC_BLOB_MAX_DEPTH);
+		return 0;
+	}
+
+	(*node_count)++;
+	if (node->content && intern_table_add(strings, node->content, strlen(node->content)) == MC_NO_STRING_ID) return 0;
+	if (node->data && intern_table_add(strings, node->data, strlen(node->data)) == MC_NO_STRING_ID) return 0;
+
+	for (int i = 0; i < node->child_count; i++) {
+		if (!collect_tree(node->children[i], depth + 1, node_count, strings)) return 0;
+	}
+	return 1;
+}
+
+static uint32_t write_string(MCBlobWriter_t *w, const char *s) {
+	if (!s) return MC_BLOB_NO_STRING;
+	return w->string_offsets[intern_table_add(w->strings, s, strlen(s))];
+}
+
+static void write_tree(MCBlobWriter_t *w, MCNode_t *node) {
+	MCBlobNode_t record = {0};
+
+	record.type = (uint8_t)node->type;
+	if (node->type == HEADER_NODE) {
+		record.header_level = node->header_level > 255 ? 255 : (uint8_t)node->header_level;
+	} else if (node->type == TABLE_ROW_NODE || node->type == TABLE_CELL_NODE) {
+		record.header_level = (uint8_t)node->table_info;
+	}
+	record.child_count = (uint32_t)node->child_count;
+	record.content = write_string(w, node->content);
+	record.data = write_string(w, node->data);
+
+	memcpy(w->blob + w->nodes_offset + (size_t)w->node_index * sizeof(MCBlobNode_t), &record, sizeof(record));
+	w->node_index++;
+
+	for (int i = 0; i < node->child_count; i++) {
+		write_tree(w, node->children[i]);
+	}
+}
+
+void *markcore_serialize_tree(MCNode_t *root, size_t *out_size) {
+	if (!root || !out_size) return NULL;
+
+	MCInternTable_t *strings = intern_table_create();
+	if (!strings) return NULL;
+
+	size_t node_count = 0;
+	if (!collect_tree(root, 0, &node_count, strings)) {
+		intern_table_destroy(strings);
+		return NULL;
+	}
+
+	size_t strings_offset = sizeof(MCBlobHeader_t) + node_count * sizeof(MCBlobNode_t);
+	size_t strings_size = strings->bytes;
+	size_t total = strings_offset + strings_size;
+
+	// caller owned, plain malloc so it can be free()d
+	uint8_t *blob = total <= UINT32_MAX ? malloc(total) : NULL;
+	uint32_t *string_offsets = mc_malloc(sizeof(uint32_t) * (strings->count + 1));
+	if (!blob || !string_offsets) {
+		if (total > UINT32_MAX) fprintf(stderr, "[Serialize] Tree too large for blob format\n");
+		free(blob);
+		mc_free(string_offsets);
+		intern_table_destroy(strings);
+		return NULL;
+	}
+
+	// lay the distinct strings out in id order
+	char *string_table = (char *)blob + strings_offset;
+	uint32_t offset = 0;
+	for (uint32_t id = 0; id < strings->count; id++) {
+		size_t len = strings->entries[id].len + 1;
+		memcpy(string_table + offset, strings->entries[id].text, len);
+		string_offsets[id] = offset;
+		offset += (uint32_t)len;
+	}
+
+	MCBlobHeader_t header = {0};
+	memcpy(header.magic, MC_BLOB_MAGIC, sizeof(MC_BLOB_MAGIC));
+	header.byte_order = MC_BLOB_BYTE_ORDER;
+	header.version = MC_BLOB_VERSION;
+	header.node_count = (uint32_t)node_count;
+	header.strings_offset = (uint32_t)strings_offset;
+	header.strings_size = (uint32_t)strings_size;
+	memcpy(blob, &header, sizeof(header));
+
+	MCBlobWriter_t w = {
+		.blob = blob,
+		.nodes_offset = sizeof(MCBlobHeader_t),
+		.node_index = 0,
+		.strings = strings,
+		.string_offsets = string_offsets,
+	};
+	write_tree(&w, root);
+
+	mc_free(string_offsets);
+	intern_table_destroy(strings);
+
+	*out_size = total;
+	return blob;
+}
+
+// Reading ======================================================
+
+// records are copied out so the blob doesn't need any particular alignment
+static void read_node(const MCBlobReader_t *b, uint32_t index, MCBlobNode_t *out) {
+	memcpy(out, b->blob + sizeof(MCBlobHeader_t) + (size_t)index * sizeof(MCBlobNode_t), sizeof(MCBlobNode_t));
+}
+
+static const char *read_string(const MCBlobReader_t *b, uint32_t offset) {
+	if (offset == MC_BLOB_NO_STRING) return NULL;
+	return b->strings + offset;
+}
+
+static int open_blob(MCBlobReader_t *b, const void *blob, size_t size) {
+	if (!blob || size < sizeof(MCBlobHeader_t)) return 0;
+
+	MCBlobHeader_t header;
+	memcpy(&header, blob, sizeof(header));
+
+	if (memcmp(header.magic, MC_BLOB_MAGIC, sizeof(MC_BLOB_MAGIC)) != 0) return 0;
+	if (header.byte_order != MC_BLOB_BYTE_ORDER) return 0;
+	if (header.version != MC_BLOB_VERSION) return 0;
+
+	size_t strings_offset = sizeof(MCBlobHeader_t) + (size_t)header.node_count * sizeof(MCBlobNode_t);
+	if (header.strings_offset != strings_offset) return 0;
+	if (strings_offset > size || size - strings_offset < header.strings_size) return 0;
+
+	b->blob = blob;
+	b->strings = (const char *)blob + strings_offset;
+	b->node_count = header.node_count;
+	b->strings_size = header.strings_size;
+	return 1;
+}
+
+static int valid_string(const MCBlobReader_t *b, uint32_t offset) {
+	return offset == MC_BLOB_NO_STRING || offset < b->strings_size;
+}
+
+// renderers write the content of text and inline code as is, the parser always sets it
+static int has_required_strings(const MCBlobNode_t *node) {
+	switch (node->type) {
+		case TEXT_NODE:
+		case CODE_INLINE_NODE:
+			return node->content != MC_BLOB_NO_STRING;
+		default:
+			return 1;
+	}
+}
+
+int markcore_validate_serialized(const void *blob, size_t size) {
+	MCBlobReader_t b;
+	if (!open_blob(&b, blob, size)) return 0;
+	if (b.node_count == 0) return 0;
+
+	// string table must end in NUL so any in-bounds offset is a terminated string
+	if (b.strings_size > 0 && b.strings[b.strings_size - 1] != '\0') return 0;
+
+	// replay the preorder layout with a stack of remaining child counts
+	uint32_t pending[MC_BLOB_MAX_DEPTH + 1];
+	int depth = 0;
+	pending[depth++] = 1;
+
+	for (uint32_t i = 0; i < b.node_count; i++) {
+		MCBlobNode_t node;
+		read_node(&b, i, &node);
+
+		if (node.type >= NODE_TYPE_COUNT) return 0;
+		if (!valid_string(&b, node.content) || !valid_string(&b, node.data)) return 0;
+		if (!has_required_strings(&node)) return 0;
+
+		while (depth > 0 && pending[depth - 1] == 0) depth--;
+		if (depth == 0) return 0; // trailing nodes outside the tree
+		pending[depth - 1]--;
+
+		if (node.child_count > 0) {
+			if (node.child_count > b.node_count - i - 1) return 0;
+			if (depth > MC_BLOB_MAX_DEPTH) return 0;
+			pending[depth++] = node.child_count;
+		}
+	}
+
+	while (depth > 0 && pending[depth - 1] == 0) depth--;
+	return depth == 0;
+}
+
+static void skip_blob_node(const MCBlobReader_t *b, uint32_t *index) {
+	MCBlobNode_t node;
+	read_node(b, *index, &node);
+	(*index)++;
+
+	for (uint32_t i = 0; i < node.child_count; i++) {
+		skip_blob_node(b, index);
+	}
+}
+
+static size_t render_blob_node(Renderer_t *r, const MCBlobReader_t *b, uint32_t *index) {
+	if (render_limit_reached(r)) {
+		skip_blob_node(b, index);
+		return 0;
+	}
+
+	MCBlobNode_t node;
+	read_node(b, *index, &node);
+	(*index)++;
+
+	// childless stand in, strings point straight into the blob
+	MCNode_t view = {
+		.type = node.type,
+		.content = (char *)read_string(b, node.content),
+		.data = (char *)read_string(b, node.data),
+		.flags = MC_NODE_BORROWED_CONTENT | MC_NODE_BORROWED_DATA,
+		.content_id = MC_NO_STRING_ID,
+		.data_id = MC_NO_STRING_ID,
+	};
+	view.header_level = node.header_level;
+
+	size_t open_bytes = render_node_open(r, &view);
+	r->output_bytes += open_bytes;
+
+	size_t child_bytes = 0;
+	for (uint32_t i = 0; i < node.child_count; i++) {
+		child_bytes += render_blob_node(r, b, index);
+	}
+
+	size_t close_bytes = render_node_close(r, &view);
+	r->output_bytes += close_bytes;
+
+	return open_bytes + child_bytes + close_bytes;
+}
+
+size_t render_serialized_tree(Renderer_t *r, const void *blob, size_t size) {
+	if (!r || !markcore_validate_serialized(blob, size)) {
+		fprintf(stderr, "[Serialize] Invalid blob\n");
+		return 0;
+	}
+
+	MCBlobReader_t b;
+	(void)open_blob(&b, blob, size);
+
+	uint32_t index = 0;
+	return render_blob_node(r, &b, &index);
+}
+
+static MCNode_t *deserialize_node(const MCBlobReader_t *b, uint32_t *index) {
+	MCBlobNode_t record;
+	read_node(b, *index, &record);
+	(*index)++;
+
+	MCNode_t *node = markcore_create_node(record.type, read_string(b, record.content));
+	if (!node) return NULL;
+
+	const char *data = read_string(b, record.data);
+	node->data = data ? mc_strdup(data) : NULL;
+	if (record.type == HEADER_NODE) node->header_level = record.header_level;
+	if (record.type == TABLE_ROW_NODE || record.type == TABLE_CELL_NODE) node->table_info = record.header_level;
+
+	for (uint32_t i = 0; i < record.child_count; i++) {
+		markcore_add_child_node(node, deserialize_node(b, index));
+	}
+
+	return node;
+}
+
+MCNode_t *markcore_deserialize_tree(const void *blob, size_t size) {
+	if (!markcore_validate_serialized(blob, size)) {
+		fprintf(stderr, "[Serialize] Invalid blob\n");
+		return NULL;
+	}
+
+	MCBlobReader_t b;
+	(void)open_blob(&b, blob, size);
+
+	uint32_t index = 0;
+	return deserialize_node(&b, &index);
+}
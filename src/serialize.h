@@ -0,0 +1,56 @@
+#ifndef MARKCORE_SERIALIZE_H
+#define MARKCORE_SERIALIZE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "renderer.h"
+
+/*
+Binary tree image, laid out as:
+
+	header | node records (preorder) | string table
+
+Every field is a fixed width integer and strings are NUL terminated and addressed
+by offset into the string table (each distinct string stored once), so a blob has no
+pointers and can be mmapped and rendered in place. Blobs are written in host byte
+order, the header records it.
+*/
+
+#define MC_BLOB_MAGIC "MCT"
+#define MC_BLOB_VERSION 3 // 2: code blocks are a single text node, 3: list items, quotes and tables
+#define MC_BLOB_BYTE_ORDER 0x01020304u
+#define MC_BLOB_NO_STRING 0xFFFFFFFFu
+#define MC_BLOB_MAX_DEPTH 512
+
+typedef struct {
+	char magic[4];
+	uint32_t byte_order;
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t strings_offset;
+	uint32_t strings_size;
+} MCBlobHeader_t;
+
+typedef struct {
+	uint8_t type;
+	uint8_t header_level; // table_info for table rows and cells
+	uint16_t reserved;
+	uint32_t child_count;
+	uint32_t content; // string table offset or MC_BLOB_NO_STRING
+	uint32_t data;
+} MCBlobNode_t;
+
+// Returns dynamically allocated blob. Please free()
+void *markcore_serialize_tree(MCNode_t *root, size_t *out_size);
+
+// Rebuild an MCNode_t tree (only needed to modify it, rendering works on the blob)
+MCNode_t *markcore_deserialize_tree(const void *blob, size_t size);
+
+// Bounds check everything once so walkers can trust offsets. Returns 1 if valid
+int markcore_validate_serialized(const void *blob, size_t size);
+
+size_t render_serialized_tree(Renderer_t *r, const void *blob, size_t size);
+
+#endif
@@ -0,0 +1,93 @@
+#include "sink.h"
+#include "alloc.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#define SINK_FORMAT_BUFFER_SIZE 256
+
+static size_t file_sink_write(MCSink_t *sink, const char *data, size_t len) {
+	return fwrite(data, 1, len, sink->file);
+}
+
+static size_t memory_sink_write(MCSink_t *sink, const char *data, size_t len) {
+	if (sink->length + len > sink->capacity) {
+		size_t capacity = sink->capacity ? sink->capacity * 2 : SINK_FORMAT_BUFFER_SIZE;
+		while (capacity < sink->length + len) capacity *= 2;
+		char *buffer = mc_realloc(sink->buffer, capacity);
+		if (!buffer) return 0;
+		sink->buffer = buffer;
+		sink->capacity = capacity;
+	}
+	
+	memcpy(sink->buffer + sink->length, data, len);
+	sink->length += len;
+	return len;
+}
+
+void sink_init_file(MCSink_t *sink, FILE *file) {
+	memset(sink, 0, sizeof(MCSink_t));
+	sink->write = file_sink_write;
+	sink->file = file;
+}
+
+void sink_init_memory(MCSink_t *sink) {
+	memset(sink, 0, sizeof(MCSink_t));
+	sink->write = memory_sink_write;
+}
+
+int sink_finish(MCSink_t *sink) {
+	if (sink->finish && !sink->finish(sink)) sink->failed = 1;
+	return !sink->failed;
+}
+
+void sink_release(MCSink_t *sink) {
+	if (!sink) return;
+	if (sink->release) sink->release(sink);
+	sink->state = NULL;
+	mc_free(sink->buffer);
+	sink->buffer = NULL;
+	sink->length = 0;
+	sink->capacity = 0;
+}
+
+size_t sink_write(MCSink_t *sink, const char *data, size_t len) {
+	if (len == 0) return 0;
+	size_t written = sink->write(sink, data, len);
+	sink->bytes_written += written;
+	if (written < len) sink->failed = 1;
+	return written;
+}
+
+size_t sink_puts(MCSink_t *sink, const char *text) {
+	return sink_write(sink, text, strlen(text));
+}
+
+size_t sink_printf(MCSink_t *sink, const char *fmt, ...) {
+	char stack_buffer[SINK_FORMAT_BUFFER_SIZE];
+	
+	va_list args;
+	va_start(args, fmt);
+	int needed = vsnprintf(stack_buffer, sizeof(stack_buffer), fmt, args);
+	va_end(args);
+	if (needed < 0) return 0;
+	
+	if ((size_t)needed < sizeof(stack_buffer)) {
+		return sink_write(sink, stack_buffer, (size_t)needed);
+	}
+	
+	// long headers/links, format again into a buffer big enough
+	char *buffer = mc_malloc((size_t)needed + 1);
+	if (!buffer) {
+		sink->failed = 1;
+		return 0;
+	}
+	
+	va_start(args, fmt);
+	vsnprintf(buffer, (size_t)needed + 1, fmt, args);
+	va_end(args);
+	
+	size_t written = sink_write(sink, buffer, (size_t)needed);
+	mc_free(buffer);
+	return written;
+}
@@ -0,0 +1,45 @@
+#ifndef MARKCORE_SINK_H
+#define MARKCORE_SINK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+Output sink, where renderers write. A sink is a write callback plus its target:
+a FILE, a growable memory buffer that the render cursor drains in chunks, or
+a filter (deflate_sink.h) that transforms bytes and passes them on to a next
+sink. Sinks live wherever the caller puts them (usually the stack), call
+sink_finish before reading what a filter produced and sink_release when done.
+*/
+
+typedef struct MCSink {
+	// returns bytes accepted, short writes mark the sink failed
+	size_t (*write)(struct MCSink *sink, const char *data, size_t len);
+	
+	FILE *file;
+	
+	// memory sinks
+	char *buffer;
+	size_t length;
+	size_t capacity;
+	
+	// filters
+	struct MCSink *next;
+	void *state;
+	int (*finish)(struct MCSink *sink); // flush everything through to next
+	void (*release)(struct MCSink *sink);
+	
+	size_t bytes_written; // everything accepted so far
+	int failed;
+} MCSink_t;
+
+void sink_init_file(MCSink_t *sink, FILE *file);
+void sink_init_memory(MCSink_t *sink);
+int sink_finish(MCSink_t *sink); // 1 if everything written so far reached its target
+void sink_release(MCSink_t *sink); // frees a memory sink's buffer, or a filter's state
+
+size_t sink_write(MCSink_t *sink, const char *data, size_t len);
+size_t sink_puts(MCSink_t *sink, const char *text);
+size_t sink_printf(MCSink_t *sink, const char *fmt, ...);
+
+#endif
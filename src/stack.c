@@ -1,9 +1,10 @@
 
 #include "stack.h"
+#include "alloc.h"
 
 Stack_t *stack_create(size_t capacity) {
-    Stack_t *s = malloc(sizeof(Stack_t));
-    s->items = malloc(sizeof(void*) * capacity);
+    Stack_t *s = mc_malloc(sizeof(Stack_t));
+    s->items = mc_malloc(sizeof(void*) * capacity);
     s->size = 0;
     s->capacity = capacity;
     return s;
@@ -12,7 +13,7 @@ Stack_t *stack_create(size_t capacity) {
 void stack_push(Stack_t *s, void *item) {
     if (s->size >= s->capacity) {
         s->capacity *= 2;
-        s->items = realloc(s->items, sizeof(void*) * s->capacity);
+        s->items = mc_realloc(s->items, sizeof(void*) * s->capacity);
     }
     s->items[s->size++] = item;
 }
@@ -28,8 +29,8 @@ void *stack_peek(Stack_t *s) {
 }
 
 void stack_free(Stack_t *s) {
-    free(s->items);
-    free(s);
+    mc_free(s->items);
+    mc_free(s);
 }
 
 void stack_print(Stack_t *s, void (*item_print)(void *item)) {
@@ -0,0 +1,130 @@
+#include "tokens.h"
+
+#include <string.h>
+
+#define TOKEN_WEIGHT_TEXT 1
+#define TOKEN_WEIGHT_EMPHASIS 2
+#define TOKEN_WEIGHT_LINK 2
+#define TOKEN_WEIGHT_HEADING_MAX 8 // h1, each level below is one less
+
+typedef struct {
+	MarkCoreToken_f callback;
+	void *userdata;
+	size_t count;
+	
+	MarkCoreToken_t token; // kind, weight, block and offset of the current context
+	size_t block_offset;
+} MCTokenWalk_t;
+
+static int is_word_byte(unsigned char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// node content starts this far into the node's source range
+static size_t content_skip(const MCNode_t *node) {
+	switch (node->type) {
+		case HEADER_NODE: return node->header_level;
+		case LINK_NODE: return 1; // [
+		case IMAGE_NODE: return 2; // ![
+		case CODE_INLINE_NODE: return 1; // `
+		default: return 0;
+	}
+}
+
+static void emit_words(MCTokenWalk_t *w, const MCNode_t *node) {
+	const char *text = node->content;
+	if (!text) return;
+	
+	// content is copied verbatim from the source, so words are offset into the node's range
+	size_t content_offset = MARKCORE_NO_OFFSET;
+	if (node->flags & MC_NODE_HAS_POSITION) content_offset = node->source_start + content_skip(node);
+	
+	const char *p = text;
+	while (*p) {
+		while (*p && !is_word_byte((unsigned char)*p)) p++;
+		if (!*p) break;
+		
+		const char *start = p;
+		while (*p && is_word_byte((unsigned char)*p)) p++;
+		
+		w->token.text = start;
+		w->token.len = p - start;
+		w->token.offset = content_offset != MARKCORE_NO_OFFSET ? content_offset + (start - text) : w->block_offset;
+		w->callback(&w->token, w->userdata);
+		w->count++;
+	}
+}
+
+static int heading_weight(int level) {
+	int weight = TOKEN_WEIGHT_HEADING_MAX - (level - 1);
+	return weight > TOKEN_WEIGHT_EMPHASIS ? weight : TOKEN_WEIGHT_EMPHASIS;
+}
+
+static void walk_node(MCTokenWalk_t *w, MCNode_t *node) {
+	MarkCoreToken_t saved = w->token;
+	
+	switch (node->type) {
+		case HEADER_NODE:
+			w->token.kind = MARKCORE_TOKEN_HEADING;
+			w->token.heading_level = node->header_level;
+			w->token.weight = heading_weight(node->header_level);
+			emit_words(w, node);
+			break;
+		case TEXT_NODE:
+			emit_words(w, node);
+			break;
+		case LINK_NODE:
+			w->token.kind = MARKCORE_TOKEN_LINK;
+			if (w->token.weight < TOKEN_WEIGHT_LINK) w->token.weight = TOKEN_WEIGHT_LINK;
+			emit_words(w, node);
+			break;
+		case IMAGE_NODE:
+			w->token.kind = MARKCORE_TOKEN_IMAGE_ALT;
+			emit_words(w, node);
+			break;
+		case CODE_INLINE_NODE:
+			w->token.kind = MARKCORE_TOKEN_CODE;
+			emit_words(w, node);
+			break;
+		case CODE_BLOCK_NODE:
+			w->token.kind = MARKCORE_TOKEN_CODE;
+			break;
+		case BOLD_NODE:
+		case ITALIC_NODE:
+		case BOLD_ITALIC_NODE:
+			w->token.kind = MARKCORE_TOKEN_EMPHASIS;
+			if (w->token.weight < TOKEN_WEIGHT_EMPHASIS) w->token.weight = TOKEN_WEIGHT_EMPHASIS;
+			break;
+		default:
+			break;
+	}
+	
+	for (int i = 0; i < node->child_count; i++) {
+		walk_node(w, node->children[i]);
+	}
+	
+	w->token = saved;
+}
+
+size_t extract_tree_tokens(MCNode_t *root, MCBlockIndex_t *blocks, MarkCoreToken_f callback, void *userdata) {
+	if (!root || !callback) return 0;
+	
+	MCTokenWalk_t w = {
+		.callback = callback,
+		.userdata = userdata,
+		.count = 0,
+	};
+	
+	for (int i = 0; i < root->child_count; i++) {
+		memset(&w.token, 0, sizeof(w.token));
+		w.token.kind = MARKCORE_TOKEN_TEXT;
+		w.token.weight = TOKEN_WEIGHT_TEXT;
+		w.token.block = i;
+		w.block_offset = (blocks && (size_t)i < blocks->count) ? blocks->offsets[i] : MARKCORE_NO_OFFSET;
+		w.token.offset = w.block_offset;
+		
+		walk_node(&w, root->children[i]);
+	}
+	
+	return w.count;
+}
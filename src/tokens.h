@@ -0,0 +1,13 @@
+#ifndef MARKCORE_TOKENS_H
+#define MARKCORE_TOKENS_H
+
+#include <stdlib.h>
+
+#include "markcore.h"
+#include "types.h"
+#include "block_index.h"
+
+// Tokens of every node under root (a document root, blocks are its children)
+size_t extract_tree_tokens(MCNode_t *root, MCBlockIndex_t *blocks, MarkCoreToken_f callback, void *userdata);
+
+#endif
@@ -2,25 +2,41 @@
 #ifndef MARKCORE_TYPES_H
 #define MARKCORE_TYPES_H
 
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "markcore.h"
+
+// values of the public MarkCoreNodeType_e
 typedef enum {
-	ROOT_NODE,
-	LINE_NODE,
-	TEXT_NODE,
-	LINK_NODE,
-	HEADER_NODE,
-	IMAGE_NODE,
-	BOLD_NODE,
-	ITALIC_NODE, 
-	CODE_INLINE_NODE,
-	UNORDERED_LIST_NODE,
-	ORDERED_LIST_NODE,
-	CODE_BLOCK_NODE,
-	BOLD_ITALIC_NODE,
-	NODE_TYPE_COUNT
+	ROOT_NODE = MARKCORE_NODE_ROOT,
+	LINE_NODE = MARKCORE_NODE_LINE,
+	TEXT_NODE = MARKCORE_NODE_TEXT,
+	LINK_NODE = MARKCORE_NODE_LINK,
+	HEADER_NODE = MARKCORE_NODE_HEADER,
+	IMAGE_NODE = MARKCORE_NODE_IMAGE,
+	BOLD_NODE = MARKCORE_NODE_BOLD,
+	ITALIC_NODE = MARKCORE_NODE_ITALIC, 
+	CODE_INLINE_NODE = MARKCORE_NODE_CODE_INLINE,
+	UNORDERED_LIST_NODE = MARKCORE_NODE_UNORDERED_LIST,
+	ORDERED_LIST_NODE = MARKCORE_NODE_ORDERED_LIST,
+	CODE_BLOCK_NODE = MARKCORE_NODE_CODE_BLOCK,
+	BOLD_ITALIC_NODE = MARKCORE_NODE_BOLD_ITALIC,
+	LIST_ITEM_NODE = MARKCORE_NODE_LIST_ITEM, // under a list, holds the item's blocks
+	BLOCKQUOTE_NODE = MARKCORE_NODE_BLOCKQUOTE,
+	TABLE_NODE = MARKCORE_NODE_TABLE, // rows, the first one is the header
+	TABLE_ROW_NODE = MARKCORE_NODE_TABLE_ROW,
+	TABLE_CELL_NODE = MARKCORE_NODE_TABLE_CELL,
+	NODE_TYPE_COUNT = MARKCORE_NODE_TYPE_COUNT
 } MCNodeType_e;
 
-typedef struct MCNode {
+// MCNode_t, opaque in markcore.h
+struct MCNode {
 	MCNodeType_e type;
+	
+	// strings owned elsewhere (intern table, url table) are flagged so freeing skips them
+	uint8_t flags;
+	
 	char *content;
 	struct MCNode **children;
 	int child_count;
@@ -29,11 +45,36 @@ typedef struct MCNode {
 	// type-specific data
 	union {
 		int header_level;
+		int table_info; // rows and cells, MC_TABLE_HEADER | MC_TABLE_ALIGN_*
+		int item_indent; // list items while parsing, columns their content is indented by
 	};
 	
+	// parents and snapshots holding the node, changed atomically so trees can be shared
+	// across threads. Also sits in padding
+	atomic_uint refcount;
+	
 	char *data;
 	
-} MCNode_t;
+	uint32_t content_id; // intern ids, MC_NO_STRING_ID when not interned
+	uint32_t data_id;
+	
+	// source byte range [start, end), only set with MC_NODE_HAS_POSITION. Sits in what
+	// was padding, so nodes are the same size with or without positions
+	uint32_t source_start;
+	uint32_t source_end;
+};
+
+#define MC_NODE_BORROWED_CONTENT (1 << 0)
+#define MC_NODE_BORROWED_DATA (1 << 1)
+#define MC_NODE_ESCAPE_FREE (1 << 2) // parser found no & < > " ' in the content, renderers can copy it as is
+#define MC_NODE_HAS_POSITION (1 << 3) // source_start/source_end are set
+
+#define MC_TABLE_ALIGN_NONE 0
+#define MC_TABLE_ALIGN_LEFT 1
+#define MC_TABLE_ALIGN_CENTER 2
+#define MC_TABLE_ALIGN_RIGHT 3
+#define MC_TABLE_ALIGN_MASK 3
+#define MC_TABLE_HEADER (1 << 2)
 
 static char *type_labels[NODE_TYPE_COUNT] = {
 	[ROOT_NODE] = "Root",
@@ -49,6 +90,11 @@ static char *type_labels[NODE_TYPE_COUNT] = {
 	[UNORDERED_LIST_NODE] = "Unordered list",
 	[ORDERED_LIST_NODE] = "Ordered list",
 	[TEXT_NODE] = "Text",
+	[LIST_ITEM_NODE] = "List item",
+	[BLOCKQUOTE_NODE] = "Blockquote",
+	[TABLE_NODE] = "Table",
+	[TABLE_ROW_NODE] = "Table row",
+	[TABLE_CELL_NODE] = "Table cell",
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "url_table.h"
+#include "alloc.h"
+#include "parser.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define URL_TABLE_INITIAL_BUCKETS 64
+
+// FNV-1a
+static uint32_t hash_url(const char *s) {
+	uint32_t h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+MCUrlTable_t *url_table_create(MarkCoreUrlRewrite_f rewrite, MarkCoreUrlRewriteBatch_f rewrite_batch, void *userdata) {
+	MCUrlTable_t *t = mc_calloc(1, sizeof(MCUrlTable_t));
+	if (!t) return NULL;
+	
+	t->buckets = mc_calloc(URL_TABLE_INITIAL_BUCKETS, sizeof(uint32_t));
+	if (!t->buckets) {
+		mc_free(t);
+		return NULL;
+	}
+	t->bucket_count = URL_TABLE_INITIAL_BUCKETS;
+	
+	t->rewrite = rewrite;
+	t->rewrite_batch = rewrite_batch;
+	t->userdata = userdata;
+	return t;
+}
+
+void url_table_destroy(MCUrlTable_t *t) {
+	if (!t) return;
+	
+	for (size_t i = 0; i < t->count; i++) {
+		mc_free(t->entries[i].url);
+		free(t->entries[i].rewritten); // from the caller's malloc
+		mc_free(t->entries[i].nodes);
+	}
+	mc_free(t->entries);
+	mc_free(t->buckets);
+	mc_free(t);
+}
+
+size_t url_table_memory(const MCUrlTable_t *t) {
+	if (!t) return 0;
+	
+	size_t bytes = sizeof(MCUrlTable_t) + sizeof(MCUrlEntry_t) * t->capacity + sizeof(uint32_t) * t->bucket_count;
+	for (size_t i = 0; i < t->count; i++) {
+		bytes += strlen(t->entries[i].url) + 1;
+		if (t->entries[i].rewritten) bytes += strlen(t->entries[i].rewritten) + 1;
+		bytes += sizeof(MCNode_t *) * t->entries[i].node_capacity;
+	}
+	return bytes;
+}
+
+static int grow_buckets(MCUrlTable_t *t) {
+	size_t bucket_count = t->bucket_count * 2;
+	uint32_t *buckets = mc_calloc(bucket_count, sizeof(uint32_t));
+	if (!buckets) return 0;
+	
+	for (size_t i = 0; i < t->count; i++) {
+		size_t slot = t->entries[i].hash & (bucket_count - 1);
+		while (buckets[slot]) slot = (slot + 1) & (bucket_count - 1);
+		buckets[slot] = (uint32_t)(i + 1);
+	}
+	
+	mc_free(t->buckets);
+	t->buckets = buckets;
+	t->bucket_count = bucket_count;
+	return 1;
+}
+
+static MCUrlEntry_t *intern_url(MCUrlTable_t *t, const char *url, int *inserted) {
+	uint32_t hash = hash_url(url);
+	size_t slot = hash & (t->bucket_count - 1);
+	
+	while (t->buckets[slot]) {
+		MCUrlEntry_t *entry = &t->entries[t->buckets[slot] - 1];
+		if (entry->hash == hash && strcmp(entry->url, url) == 0) {
+			*inserted = 0;
+			return entry;
+		}
+		slot = (slot + 1) & (t->bucket_count - 1);
+	}
+	
+	// keep load factor under 1/2
+	if ((t->count + 1) * 2 > t->bucket_count) {
+		if (!grow_buckets(t)) return NULL;
+		return intern_url(t, url, inserted);
+	}
+	
+	if (t->count == t->capacity) {
+		size_t capacity = t->capacity ? t->capacity * 2 : 16;
+		MCUrlEntry_t *entries = mc_realloc(t->entries, sizeof(MCUrlEntry_t) * capacity);
+		if (!entries) return NULL;
+		t->entries = entries;
+		t->capacity = capacity;
+	}
+	
+	MCUrlEntry_t *entry = &t->entries[t->count];
+	memset(entry, 0, sizeof(MCUrlEntry_t));
+	entry->url = mc_strdup(url);
+	entry->hash = hash;
+	if (!entry->url) return NULL;
+	
+	t->buckets[slot] = (uint32_t)(t->count + 1);
+	t->count++;
+	
+	*inserted = 1;
+	return entry;
+}
+
+// nodes borrow the rewritten url from the table instead of each holding a copy
+static void patch_node(MCUrlEntry_t *entry, MCNode_t *node) {
+	if (!entry->rewritten) return;
+	markcore_node_set_data(node, entry->rewritten);
+	node->flags |= MC_NODE_BORROWED_DATA;
+}
+
+void url_table_bind(MCUrlTable_t *t, MCNode_t *node) {
+	if (!t || !node || !node->data) return;
+	
+	int inserted = 0;
+	MCUrlEntry_t *entry = intern_url(t, node->data, &inserted);
+	if (!entry) {
+		fprintf(stderr, "[URL table] Failed to intern %s\n", node->data);
+		return;
+	}
+	
+	// a url the last flush already rewrote is patched right away
+	if (t->rewrite_batch && (size_t)(entry - t->entries) >= t->flushed) {
+		if (entry->node_count == entry->node_capacity) {
+			size_t capacity = entry->node_capacity ? entry->node_capacity * 2 : 2;
+			MCNode_t **nodes = mc_realloc(entry->nodes, sizeof(MCNode_t *) * capacity);
+			if (!nodes) return;
+			entry->nodes = nodes;
+			entry->node_capacity = capacity;
+		}
+		entry->nodes[entry->node_count++] = node;
+		return;
+	}
+	
+	if (inserted && t->rewrite && !t->rewrite_batch) {
+		entry->rewritten = t->rewrite(entry->url, t->userdata);
+	}
+	patch_node(entry, node);
+}
+
+void url_table_flush(MCUrlTable_t *t) {
+	if (!t || !t->rewrite_batch || t->flushed == t->count) return;
+	
+	size_t count = t->count - t->flushed;
+	MCUrlEntry_t *pending = t->entries + t->flushed;
+	
+	const char **urls = mc_malloc(sizeof(char *) * count);
+	char **rewritten = mc_calloc(count, sizeof(char *));
+	if (!urls || !rewritten) {
+		mc_free(urls);
+		mc_free(rewritten);
+		return;
+	}
+	
+	for (size_t i = 0; i < count; i++) urls[i] = pending[i].url;
+	
+	t->rewrite_batch(urls, rewritten, count, t->userdata);
+	
+	for (size_t i = 0; i < count; i++) {
+		MCUrlEntry_t *entry = &pending[i];
+		entry->rewritten = rewritten[i];
+		
+		for (size_t n = 0; n < entry->node_count; n++) {
+			patch_node(entry, entry->nodes[n]);
+		}
+		mc_free(entry->nodes);
+		entry->nodes = NULL;
+		entry->node_count = entry->node_capacity = 0;
+	}
+	t->flushed = t->count;
+	
+	mc_free(urls);
+	mc_free(rewritten);
+}
@@ -0,0 +1,55 @@
+#ifndef MARKCORE_URL_TABLE_H
+#define MARKCORE_URL_TABLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "markcore.h"
+#include "types.h"
+
+/*
+Per document set of distinct link/image urls. The parser binds every LINK_NODE and
+IMAGE_NODE as it creates them, so each distinct url is rewritten exactly once:
+either immediately through the per url callback, or all together through the batch
+callback when the parse finishes (url_table_flush). Edits parse into the same table, so a
+later flush only batches the urls added since the last one.
+*/
+
+typedef struct {
+	char *url;
+	char *rewritten; // NULL if left unchanged
+	uint32_t hash;
+	
+	// nodes waiting on a batch rewrite
+	MCNode_t **nodes;
+	size_t node_count;
+	size_t node_capacity;
+} MCUrlEntry_t;
+
+typedef struct MCUrlTable {
+	MCUrlEntry_t *entries;
+	size_t count;
+	size_t capacity;
+	size_t flushed; // entries before this went through the batch rewrite already
+	
+	uint32_t *buckets; // entry index + 1, 0 is empty
+	size_t bucket_count; // power of two
+	
+	MarkCoreUrlRewrite_f rewrite;
+	MarkCoreUrlRewriteBatch_f rewrite_batch; // takes precedence over rewrite
+	void *userdata;
+} MCUrlTable_t;
+
+MCUrlTable_t *url_table_create(MarkCoreUrlRewrite_f rewrite, MarkCoreUrlRewriteBatch_f rewrite_batch, void *userdata);
+void url_table_destroy(MCUrlTable_t *t);
+
+// Bytes held, rewritten urls included
+size_t url_table_memory(const MCUrlTable_t *t);
+
+// Intern node->data, replacing it with the rewritten url when one is known
+void url_table_bind(MCUrlTable_t *t, MCNode_t *node);
+
+// Run the batch rewrite (if any) over the urls added since the last flush and patch the waiting nodes
+void url_table_flush(MCUrlTable_t *t);
+
+#endif
@@ -0,0 +1,454 @@
+#include "markcore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Regression tests for behaviour the fuzz targets can't see, run by ctest one case per
+process: markcore-tests <case> [files...]. A failed check prints where and returns 1.
+The tests link an instrumented build of the library, so allocations can be counted.
+Build with -DADDRESS_SANITIZER=ON to have leaks fail the case as well.
+*/
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	} \
+} while (0)
+
+// whole html of the document, malloc()ed
+static char *render_html(MCDocument_t *doc) {
+	MCRenderStream_t *stream = markcore_render_stream_create(doc);
+	if (!stream) return NULL;
+	
+	size_t length = 0;
+	size_t capacity = 4096;
+	char *html = malloc(capacity);
+	while (html && !markcore_render_stream_done(stream)) {
+		if (capacity - length < 1024) {
+			capacity *= 2;
+			char *grown = realloc(html, capacity);
+			if (!grown) {
+				free(html);
+				html = NULL;
+				break;
+			}
+			html = grown;
+		}
+		length += markcore_render_stream_read(stream, html + length, capacity - length - 1);
+	}
+	if (html) html[length] = '\0';
+	
+	markcore_render_stream_free(stream);
+	return html;
+}
+
+static size_t count_occurrences(const char *haystack, const char *needle) {
+	size_t count = 0;
+	for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle)) count++;
+	return count;
+}
+
+// whole contents of an open file, malloc()ed
+static char *read_stream(FILE *fp, size_t *length) {
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	rewind(fp);
+	
+	char *data = size >= 0 ? malloc((size_t)size + 1) : NULL;
+	if (data && fread(data, 1, (size_t)size, fp) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	if (data) {
+		data[size] = '\0';
+		*length = (size_t)size;
+	}
+	return data;
+}
+
+// whole file, malloc()ed
+static char *read_file(const char *path, size_t *length) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		fprintf(stderr, "Couldn't open file: %s\n", path);
+		return NULL;
+	}
+	
+	char *data = read_stream(fp, length);
+	fclose(fp);
+	return data;
+}
+
+// Url rewriting ===========================================
+
+typedef struct {
+	int batch_calls;
+	size_t urls_rewritten;
+} MCRewriteCounts_t;
+
+static void rewrite_batch(const char **urls, char **rewritten, size_t count, void *userdata) {
+	MCRewriteCounts_t *counts = userdata;
+	counts->batch_calls++;
+	counts->urls_rewritten += count;
+	
+	for (size_t i = 0; i < count; i++) {
+		rewritten[i] = malloc(strlen(urls[i]) + 5);
+		if (rewritten[i]) sprintf(rewritten[i], "/cdn%s", urls[i]);
+	}
+}
+
+// edits parse into the document's url table, only urls it hasn't seen get rewritten
+static int test_url_rewrite_replace(int file_count, char **files) {
+	(void)file_count;
+	(void)files;
+	const char *markdown = "[a](/a) and [b](/b)\n\n[a again](/a)\n";
+	MCRewriteCounts_t counts = {0};
+	MarkCoreOptions_t options = {0};
+	options.url_rewrite_batch = rewrite_batch;
+	options.url_rewrite_userdata = &counts;
+	
+	MCDocument_t *doc = markcore_document_parse_with_options(markdown, strlen(markdown), &options);
+	CHECK(doc);
+	CHECK(counts.batch_calls == 1 && counts.urls_rewritten == 2);
+	
+	MCDocument_t *snapshot = markcore_document_snapshot(doc);
+	CHECK(snapshot);
+	
+	const char *edit = "[b](/b) and [c](/c)\n";
+	CHECK(markcore_document_replace_blocks(doc, 1, 2, edit, strlen(edit)));
+	CHECK(counts.batch_calls == 2 && counts.urls_rewritten == 3);
+	
+	char *html = render_html(doc);
+	CHECK(html);
+	CHECK(strstr(html, "href=\"/cdn/a\"") && strstr(html, "href=\"/cdn/b\"") && strstr(html, "href=\"/cdn/c\""));
+	free(html);
+	
+	// the snapshot still reads the rewrites of the first parse
+	html = render_html(snapshot);
+	CHECK(html);
+	CHECK(count_occurrences(html, "href=\"/cdn/a\"") == 2);
+	free(html);
+	
+	markcore_document_free(snapshot);
+	markcore_document_free(doc);
+	return 0;
+}
+
+// Highlighting ===========================================
+
+static char *highlight_upper(const char *code, size_t length, const char *lang, size_t *out_length, void *userdata) {
+	(void)lang;
+	(void)userdata;
+	char *html = malloc(length + 1);
+	if (!html) return NULL;
+	
+	for (size_t i = 0; i < length; i++) html[i] = (code[i] >= 'a' && code[i] <= 'z') ? code[i] - 'a' + 'A' : code[i];
+	html[length] = '\0';
+	*out_length = length;
+	return html;
+}
+
+// snapshots render on other threads, they highlight without touching the shared cache
+static int test_snapshot_highlight(int file_count, char **files) {
+	(void)file_count;
+	(void)files;
+	const char *markdown = "```c\nint x;\n```\n";
+	MCHighlightCache_t *cache = markcore_highlight_cache_create(0);
+	CHECK(cache);
+	
+	MarkCoreOptions_t options = {0};
+	options.highlight = highlight_upper;
+	options.highlight_cache = cache;
+	
+	MCDocument_t *doc = markcore_document_parse_with_options(markdown, strlen(markdown), &options);
+	CHECK(doc);
+	char *html = render_html(doc);
+	CHECK(html && strstr(html, "INT X;"));
+	free(html);
+	
+	size_t hits, misses;
+	markcore_highlight_cache_stats(cache, &hits, &misses, NULL);
+	CHECK(hits == 0 && misses == 1);
+	
+	MCDocument_t *snapshot = markcore_document_snapshot(doc);
+	CHECK(snapshot);
+	html = render_html(snapshot);
+	CHECK(html && strstr(html, "INT X;"));
+	free(html);
+	
+	markcore_highlight_cache_stats(cache, &hits, &misses, NULL);
+	CHECK(hits == 0 && misses == 1);
+	
+	markcore_document_free(snapshot);
+	markcore_document_free(doc);
+	markcore_highlight_cache_free(cache);
+	return 0;
+}
+
+// Headings ===========================================
+
+// a heading inserted above one with the same text must not take its anchor
+static int test_replace_heading_anchor(int file_count, char **files) {
+	(void)file_count;
+	(void)files;
+	const char *markdown = "# Setup\n\nSome text\n\n# Usage\n";
+	MarkCoreOptions_t options = {0};
+	options.heading_ids = 1;
+	
+	MCDocument_t *doc = markcore_document_parse_with_options(markdown, strlen(markdown), &options);
+	CHECK(doc);
+	
+	const char *edit = "# Usage\n";
+	CHECK(markcore_document_replace_blocks(doc, 1, 2, edit, strlen(edit)));
+	
+	char *html = render_html(doc);
+	CHECK(html);
+	CHECK(count_occurrences(html, "id=\"usage\"") == 1);
+	CHECK(count_occurrences(html, "id=\"usage-1\"") == 1);
+	
+	// the kept heading keeps its anchor, links to it still land in the same place
+	const char *kept = strstr(html, "id=\"usage\"");
+	const char *inserted = strstr(html, "id=\"usage-1\"");
+	CHECK(inserted < kept);
+	free(html);
+	
+	markcore_document_free(doc);
+	return 0;
+}
+
+// Passes ===========================================
+
+typedef struct {
+	size_t links;
+	size_t text_nodes;
+	int saw_url;
+} MCPassCounts_t;
+
+static void count_pre(const MCNode_t *node, void *userdata) {
+	MCPassCounts_t *counts = userdata;
+	if (markcore_node_type(node) == MARKCORE_NODE_LINK) {
+		counts->links++;
+		const char *url = markcore_node_data(node);
+		if (url && strcmp(url, "/a") == 0) counts->saw_url = 1;
+	}
+}
+
+static void count_post(const MCNode_t *node, void *userdata) {
+	MCPassCounts_t *counts = userdata;
+	if (markcore_node_type(node) == MARKCORE_NODE_TEXT && markcore_node_content(node)) counts->text_nodes++;
+}
+
+// hooks see only the node types they asked for, once per render or walk
+static int test_pass_pipeline(int file_count, char **files) {
+	(void)file_count;
+	(void)files;
+	const char *markdown = "Some [link](/a) and `code`\n\n# Title\n";
+	MCDocument_t *doc = markcore_document_parse(markdown, strlen(markdown));
+	CHECK(doc);
+	
+	MCPassCounts_t counts = {0};
+	MarkCorePass_t pass = {0};
+	pass.name = "count";
+	pass.node_mask = MARKCORE_NODE_MASK(MARKCORE_NODE_LINK) | MARKCORE_NODE_MASK(MARKCORE_NODE_TEXT);
+	pass.pre = count_pre;
+	pass.post = count_post;
+	pass.userdata = &counts;
+	
+	MCPassPipeline_t *pipeline = markcore_pass_pipeline_create();
+	CHECK(pipeline);
+	CHECK(!markcore_pass_pipeline_register(pipeline, &pass)); // version not set
+	pass.version = MARKCORE_PASS_VERSION;
+	CHECK(markcore_pass_pipeline_register(pipeline, &pass));
+	
+	FILE *out = tmpfile();
+	CHECK(out);
+	CHECK(markcore_document_render_with_passes(doc, pipeline, out) > 0);
+	fclose(out);
+	CHECK(counts.links == 1 && counts.saw_url);
+	
+	size_t text_nodes = counts.text_nodes;
+	CHECK(text_nodes > 0);
+	markcore_pass_pipeline_run(pipeline, doc);
+	CHECK(counts.links == 2 && counts.text_nodes == text_nodes * 2);
+	
+	markcore_pass_pipeline_free(pipeline);
+	markcore_document_free(doc);
+	return 0;
+}
+
+// Peak memory ===========================================
+
+static char *rewrite_url(const char *url, void *userdata) {
+	(void)userdata;
+	char *rewritten = malloc(strlen(url) + 5);
+	if (rewritten) sprintf(rewritten, "/cdn%s", url);
+	return rewritten;
+}
+
+// every option that keeps something per document on, so the peak is the largest a parse gets
+static int check_parse_peak(int file_count, char **files, size_t base_bytes, size_t bytes_per_byte) {
+	CHECK(file_count > 0);
+	
+	MarkCoreOptions_t options = {0};
+	options.heading_ids = 1;
+	options.sourcepos_attributes = 1;
+	options.intern_strings = 1;
+	options.url_rewrite = rewrite_url;
+	options.shrink_to_fit = 1;
+	
+	for (int i = 0; i < file_count; i++) {
+		size_t length = 0;
+		char *markdown = read_file(files[i], &length);
+		CHECK(markdown);
+		
+		MarkCoreAllocStats_t before, after;
+		markcore_alloc_stats_reset();
+		CHECK(markcore_alloc_stats(&before));
+		MCDocument_t *doc = markcore_document_parse_with_options(markdown, length, &options);
+		CHECK(doc);
+		markcore_alloc_stats(&after);
+		
+		size_t peak = after.peak_bytes - before.live_bytes;
+		size_t budget = base_bytes + bytes_per_byte * length;
+		printf("%s: %zu bytes peaked at %zu (%.2f per byte), budget %zu\n", files[i], length, peak,
+			   length ? (double)peak / length : 0.0, budget);
+		CHECK(peak <= budget);
+		
+		markcore_document_free(doc);
+		free(markdown);
+	}
+	return 0;
+}
+
+static int test_document_peak(int file_count, char **files) {
+	return check_parse_peak(file_count, files, MARKCORE_PEAK_BASE_BYTES, MARKCORE_PEAK_BYTES_PER_INPUT_BYTE);
+}
+
+static int test_worst_case_peak(int file_count, char **files) {
+	return check_parse_peak(file_count, files, MARKCORE_PEAK_BASE_BYTES, MARKCORE_PEAK_WORST_BYTES_PER_INPUT_BYTE);
+}
+
+// Terminal output ===========================================
+
+// no control sequence in the document reaches the terminal, raw or UTF-8, and text stays intact
+static int test_terminal_escape(int file_count, char **files) {
+	(void)file_count;
+	(void)files;
+	const char *markdown = "raw \x9b" "31m osc \x9d" "0;x\x07 utf8 \xc2\x9b" "2J esc \x1b" "[1m "
+						   "kept \xc3\xa9 \xe2\x80\x9b \xc2\xa0 cut \xe2\x9b" "A\n";
+	MCDocument_t *doc = markcore_document_parse(markdown, strlen(markdown));
+	CHECK(doc);
+	
+	FILE *out = tmpfile();
+	CHECK(out);
+	CHECK(markcore_document_render_format_to_file(doc, MARKCORE_FORMAT_ANSI, out) > 0);
+	size_t length = 0;
+	char *text = read_stream(out, &length);
+	fclose(out);
+	CHECK(text);
+	
+	CHECK(strstr(text, "raw ?31m osc ?0;x? utf8 ?2J esc ?[1m "));
+	CHECK(strstr(text, "kept \xc3\xa9 \xe2\x80\x9b \xc2\xa0 cut \xe2?A"));
+	free(text);
+	
+	markcore_document_free(doc);
+	return 0;
+}
+
+// Serialization ===========================================
+
+// a blob renders the same html in place and rebuilt as the document it came from
+static int test_serialized_round_trip(int file_count, char **files) {
+	CHECK(file_count > 0);
+	
+	for (int i = 0; i < file_count; i++) {
+		size_t length = 0;
+		char *markdown = read_file(files[i], &length);
+		CHECK(markdown);
+		
+		MCDocument_t *doc = markcore_document_parse(markdown, length);
+		CHECK(doc);
+		char *expected = render_html(doc);
+		CHECK(expected);
+		
+		size_t size = 0;
+		void *blob = markcore_document_serialize(doc, &size);
+		CHECK(blob && size > 0);
+		
+		MCDocument_t *rebuilt = markcore_document_deserialize(blob, size);
+		CHECK(rebuilt);
+		char *html = render_html(rebuilt);
+		CHECK(html && strcmp(html, expected) == 0);
+		free(html);
+		markcore_document_free(rebuilt);
+		
+		FILE *out = tmpfile();
+		CHECK(out);
+		CHECK(markcore_render_serialized_to_file(blob, size, out) > 0);
+		size_t html_length = 0;
+		html = read_stream(out, &html_length);
+		fclose(out);
+		CHECK(html && strcmp(html, expected) == 0);
+		free(html);
+		
+		free(blob);
+		free(expected);
+		markcore_document_free(doc);
+		free(markdown);
+	}
+	return 0;
+}
+
+// blobs from fuzz/regressions that once crashed a render, validation has to turn them away
+static int test_corrupt_blobs(int file_count, char **files) {
+	CHECK(file_count > 0);
+	
+	FILE *out = tmpfile();
+	CHECK(out);
+	for (int i = 0; i < file_count; i++) {
+		size_t size = 0;
+		char *blob = read_file(files[i], &size);
+		CHECK(blob);
+		
+		CHECK(markcore_document_deserialize(blob, size) == NULL);
+		CHECK(markcore_render_serialized_to_file(blob, size, out) == 0);
+		free(blob);
+	}
+	fclose(out);
+	return 0;
+}
+
+// Cases ===========================================
+
+typedef struct {
+	const char *name;
+	int (*run)(int file_count, char **files);
+} MCTestCase_t;
+
+static const MCTestCase_t test_cases[] = {
+	{"url-rewrite-replace", test_url_rewrite_replace},
+	{"snapshot-highlight", test_snapshot_highlight},
+	{"replace-heading-anchor", test_replace_heading_anchor},
+	{"pass-pipeline", test_pass_pipeline},
+	{"terminal-escape", test_terminal_escape},
+	{"serialized-round-trip", test_serialized_round_trip},
+	{"corrupt-blobs", test_corrupt_blobs},
+	{"document-peak", test_document_peak},
+	{"worst-case-peak", test_worst_case_peak},
+};
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <case> [files...]\n", argv[0]);
+		return 2;
+	}
+	
+	for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+		if (strcmp(argv[1], test_cases[i].name) == 0) return test_cases[i].run(argc - 2, argv + 2);
+	}
+	fprintf(stderr, "Unknown case: %s\n", argv[1]);
+	return 2;
+}
@@ -3,16 +3,279 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#define PROFILE_DEFAULT_RUNS 100
+#define PROFILE_DEFAULT_TOP 10
+
+static int parse_format(const char *name, MarkCoreFormat_e *format) {
+	if (strcmp(name, "html") == 0) *format = MARKCORE_FORMAT_HTML;
+	else if (strcmp(name, "text") == 0) *format = MARKCORE_FORMAT_TEXT;
+	else if (strcmp(name, "json") == 0) *format = MARKCORE_FORMAT_JSON;
+	else if (strcmp(name, "ansi") == 0) *format = MARKCORE_FORMAT_ANSI;
+	else return 0;
+	return 1;
+}
+
+// Profiling ===========================================
+
+typedef struct {
+	unsigned long long *line_ns; // inline parse time per source line, summed over runs
+	size_t line_count;
+} MCProfileLines_t;
+
+static void record_inline_parse(size_t line, unsigned long long ns, void *userdata) {
+	MCProfileLines_t *lines = userdata;
+	if (line == 0 || line > lines->line_count) return;
+	lines->line_ns[line - 1] += ns;
+}
+
+static unsigned long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static int compare_ns(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+	return (x > y) - (x < y);
+}
+
+// nearest rank percentile of sorted samples
+static double percentile_us(const unsigned long long *sorted, int count, int percent) {
+	int rank = (count * percent + 99) / 100;
+	if (rank < 1) rank = 1;
+	return sorted[rank - 1] / 1000.0;
+}
+
+static void print_phase(const char *name, unsigned long long *samples, int runs) {
+	qsort(samples, runs, sizeof(unsigned long long), compare_ns);
+	printf("  %-8s %10.1f %10.1f %10.1f\n", name,
+		   percentile_us(samples, runs, 50), percentile_us(samples, runs, 99), samples[runs - 1] / 1000.0);
+}
+
+static void print_allocations(const char *name, const MarkCoreAllocStats_t *stats) {
+	printf("  %-8s %10zu allocations %12zu bytes, peak %zu bytes live\n",
+		   name, stats->allocations, stats->bytes_allocated, stats->peak_bytes);
+}
+
+static void print_line(const char *markdown, size_t length, size_t line) {
+	const char *p = markdown;
+	const char *end = markdown + length;
+	for (size_t n = 1; n < line && p < end; p++) {
+		if (*p == '\n') n++;
+	}
+	
+	const char *line_end = p;
+	while (line_end < end && *line_end != '\n' && line_end - p < 60) line_end++;
+	printf("%.*s%s\n", (int)(line_end - p), p, line_end < end && *line_end != '\n' ? "..." : "");
+}
+
+typedef struct {
+	const char *path;
+	const char *markdown;
+	size_t length;
+	int runs;
+	int top;
+	
+	FILE *null_out;
+	unsigned long long *parse_ns;
+	unsigned long long *render_ns;
+	unsigned long long *total_ns;
+	size_t *node_counts;
+	MCProfileLines_t lines;
+} MCProfile_t;
+
+/*
+Latency runs parse and render without the inline profile callback, so its clock reads
+don't end up in the numbers. The first run warms up, isn't timed and counts the nodes.
+*/
+static int time_runs(MCProfile_t *p, MarkCoreAllocStats_t *parse_allocs, MarkCoreAllocStats_t *render_allocs,
+					 int *counted, size_t *node_total) {
+	for (int run = -1; run < p->runs; run++) {
+		markcore_alloc_stats_reset();
+		unsigned long long started = now_ns();
+		MCDocument_t *doc = markcore_document_parse(p->markdown, p->length);
+		unsigned long long parsed = now_ns();
+		if (!doc) {
+			fprintf(stderr, "Failed to parse %s\n", p->path);
+			return 1;
+		}
+		*counted = markcore_alloc_stats(parse_allocs);
+		
+		markcore_alloc_stats_reset();
+		unsigned long long render_started = now_ns();
+		markcore_document_render_to_file(doc, p->null_out);
+		fflush(p->null_out);
+		unsigned long long rendered = now_ns();
+		(void)markcore_alloc_stats(render_allocs);
+		
+		if (run >= 0) {
+			p->parse_ns[run] = parsed - started;
+			p->render_ns[run] = rendered - render_started;
+			p->total_ns[run] = p->parse_ns[run] + p->render_ns[run];
+		} else {
+			*node_total = markcore_document_count_nodes(doc, p->node_counts);
+		}
+		markcore_document_free(doc);
+	}
+	return 0;
+}
+
+// Separate parse only runs with the callback on, for the per line costs
+static int time_lines(MCProfile_t *p) {
+	MarkCoreOptions_t options = {0};
+	options.inline_profile = record_inline_parse;
+	options.inline_profile_userdata = &p->lines;
+	
+	for (int run = 0; run < p->runs; run++) {
+		MCDocument_t *doc = markcore_document_parse_with_options(p->markdown, p->length, &options);
+		if (!doc) {
+			fprintf(stderr, "Failed to parse %s\n", p->path);
+			return 1;
+		}
+		markcore_document_free(doc);
+	}
+	return 0;
+}
+
+static int run_profile(MCProfile_t *p) {
+	MarkCoreAllocStats_t parse_allocs = {0};
+	MarkCoreAllocStats_t render_allocs = {0};
+	int counted = 0;
+	size_t node_total = 0;
+	
+	if (time_runs(p, &parse_allocs, &render_allocs, &counted, &node_total) || time_lines(p)) return 1;
+	
+	printf("%s: %zu bytes, %zu lines, %d runs\n\n", p->path, p->length, p->lines.line_count, p->runs);
+	
+	printf("latency (us)       p50        p99        max\n");
+	print_phase("parse", p->parse_ns, p->runs);
+	print_phase("render", p->render_ns, p->runs);
+	print_phase("total", p->total_ns, p->runs);
+	
+	printf("\nallocations (per run)\n");
+	if (counted) {
+		print_allocations("parse", &parse_allocs);
+		print_allocations("render", &render_allocs);
+	} else {
+		printf("  not counted, build with -DMARKCORE_INSTRUMENT=ON\n");
+	}
+	
+	printf("\nnodes %zu\n", node_total);
+	for (size_t type = 0; type < markcore_node_type_count(); type++) {
+		if (p->node_counts[type]) printf("  %-16s %8zu\n", markcore_node_type_name(type), p->node_counts[type]);
+	}
+	
+	printf("\nslowest lines (inline parse, mean us per run, separate runs from latency)\n");
+	for (int k = 0; k < p->top; k++) {
+		size_t slowest = 0;
+		for (size_t i = 1; i < p->lines.line_count; i++) {
+			if (p->lines.line_ns[i] > p->lines.line_ns[slowest]) slowest = i;
+		}
+		if (p->lines.line_ns[slowest] == 0) break;
+		
+		printf("  %6zu %8.2f  ", slowest + 1, p->lines.line_ns[slowest] / 1000.0 / p->runs);
+		print_line(p->markdown, p->length, slowest + 1);
+		p->lines.line_ns[slowest] = 0;
+	}
+	return 0;
+}
+
+/*
+Parse and render (HTML, to /dev/null) runs times and report per phase latency, allocations
+(MARKCORE_INSTRUMENT builds), nodes by type and the lines whose inline parse cost the most.
+Everything is allocated here and freed on the way out, whatever the runs returned.
+*/
+static int profile(const char *path, const char *markdown, size_t length, int runs, int top) {
+	MCProfile_t p = {0};
+	p.path = path;
+	p.markdown = markdown;
+	p.length = length;
+	p.runs = runs;
+	p.top = top;
+	
+	p.lines.line_count = 1;
+	for (size_t i = 0; i < length; i++) p.lines.line_count += markdown[i] == '\n';
+	
+	p.null_out = fopen("/dev/null", "w");
+	p.parse_ns = calloc(runs, sizeof(unsigned long long));
+	p.render_ns = calloc(runs, sizeof(unsigned long long));
+	p.total_ns = calloc(runs, sizeof(unsigned long long));
+	p.node_counts = calloc(markcore_node_type_count(), sizeof(size_t));
+	p.lines.line_ns = calloc(p.lines.line_count, sizeof(unsigned long long));
+	
+	int result = 1;
+	if (!p.null_out) {
+		fprintf(stderr, "Couldn't open /dev/null\n");
+	} else if (!p.parse_ns || !p.render_ns || !p.total_ns || !p.node_counts || !p.lines.line_ns) {
+		fprintf(stderr, "Out of memory\n");
+	} else {
+		result = run_profile(&p);
+	}
+	
+	free(p.parse_ns);
+	free(p.render_ns);
+	free(p.total_ns);
+	free(p.node_counts);
+	free(p.lines.line_ns);
+	if (p.null_out) fclose(p.null_out);
+	return result;
+}
+
+// Positive count for --runs / --top, 0 for anything else
+static int parse_count(const char *value, int *count) {
+	char *end;
+	long n = strtol(value, &end, 10);
+	if (end == value || *end != '\0' || n < 1 || n > INT_MAX) return 0;
+	*count = (int)n;
+	return 1;
+}
+
+static int usage(const char *program) {
+	fprintf(stderr, "Usage: %s [--format html|text|json|ansi] <file.md>\n", program);
+	fprintf(stderr, "       %s --profile [--runs N] [--top K] <file.md>\n", program);
+	return 1;
+}
 
 int main(int argc, char **argv) {
-	if (argc < 2) {
-        fprintf(stderr, "Usage: %s <file.md>\n", argv[0]);
-        return 1;
-    }
+	const char *path = NULL;
+	MarkCoreFormat_e format = MARKCORE_FORMAT_HTML;
+	int profiling = 0;
+	int runs = PROFILE_DEFAULT_RUNS;
+	int top = PROFILE_DEFAULT_TOP;
+	
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			if (!parse_format(argv[++i], &format)) {
+				fprintf(stderr, "Unknown format: %s (html, text, json, ansi)\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--profile") == 0) {
+			profiling = 1;
+		} else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+			if (!parse_count(argv[++i], &runs)) {
+				fprintf(stderr, "--runs takes a positive number, not %s\n", argv[i]);
+				return usage(argv[0]);
+			}
+		} else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+			if (!parse_count(argv[++i], &top)) {
+				fprintf(stderr, "--top takes a positive number, not %s\n", argv[i]);
+				return usage(argv[0]);
+			}
+		} else {
+			path = argv[i];
+		}
+	}
+	
+	if (!path) return usage(argv[0]);
     
-    FILE *fp = fopen(argv[1], "r");
+    FILE *fp = fopen(path, "r");
     if (!fp) {
-    	fprintf(stderr, "Couldn't open file: %s\n", argv[1]);
+    	fprintf(stderr, "Couldn't open file: %s\n", path);
     	return 1;
     }
     
@@ -25,13 +288,25 @@ int main(int argc, char **argv) {
     buffer[size] = '\0';
     fclose(fp);
     
+	if (profiling) {
+		int result = profile(path, buffer, size, runs, top);
+		free(buffer);
+		return result;
+	}
+    
 //     fp = fopen("output.html", "w");
 //     if (!fp) {
 //     	fprintf(stderr, "Couldn't open output file\n");
 //     	return 1;
 //     }
     
-	size_t bytes_written = markcore_render_to_file(buffer, size, stdout);
+	if (format == MARKCORE_FORMAT_HTML) {
+		markcore_render_to_file(buffer, size, stdout);
+	} else {
+		MCDocument_t *doc = markcore_document_parse(buffer, size);
+		markcore_document_render_format_to_file(doc, format, stdout);
+		markcore_document_free(doc);
+	}
     
     free(buffer);
     